@@ -8,6 +8,9 @@
 #include <regex>
 #include <queue>
 #include <mutex>
+#include <memory>
+#include <set>
+#include <atomic>
 #include <json/json.h>
 
 // Include SDK headers
@@ -15,33 +18,121 @@
 #include "ins_common.h"
 #include "exif_metadata.h"  // For adding 360° EXIF metadata
 #include "resolution_detector.h"  // For dynamic resolution detection
+#include "media_metadata.h"  // For the per-job metadata snapshot
+#include "metadata_harvester.h"  // For background metadata reads during scans
+#include "rendition_ladder.h"  // For post-stitch rendition ladder
+#include "cubemap_tiles.h"  // For web viewer cubemap tile pyramids
+#include "video_chunks.h"  // For GOP-aligned chunk plans and their checkpoints
+#include "mp4_concat.h"  // For joining stitched chunks without re-encoding
+#include "spherical_metadata.h"  // For 360° video metadata (sv3d/st3d)
+#include "concurrency_controller.h"  // For adaptive worker counts
 
 namespace fs = std::filesystem;
 
+// Whether the SDK can stitch a time range of a video. CMake probes for
+// VideoStitcher::SetClipRange(startMs, endMs); that name is not in the documented SDK API
+// and still has to be confirmed on a release that supports ranges.
+#ifdef INS_HAS_CLIP_RANGE
+constexpr bool kSdkHasClipRange = true;
+#else
+constexpr bool kSdkHasClipRange = false;
+#endif
+
+// Shared state of a video stitched as separate time chunks
+struct ChunkedVideo {
+    std::string chunkDir;       // <output>.chunks/
+    VideoOutputInfo output;
+    ChunkPlan plan;             // Guarded by mutex, checkpointed to the manifest
+    int outstanding = 0;        // Chunk jobs queued or running
+    bool failed = false;
+    std::mutex mutex;
+};
+
+// Two-tier mode: a quick low-resolution preview first, then the full-quality stitch
+enum class JobTier {
+    Preview,
+    Full,
+};
+
 struct ConversionJob {
     std::string inputPath;
     std::string outputPath;
     std::string fileType;
-    std::chrono::system_clock::time_point createdAt;
+    std::chrono::system_clock::time_point createdAt; // Scan that found the input (kept by its later jobs)
+    std::shared_ptr<const MediaMetadata> metadata; // Parsed once, shared by every stage of the job
+    double estimatedCost = 0.0; // Output megapixels to render (all frames for videos)
+    JobTier tier = JobTier::Full;
+    std::shared_ptr<ChunkedVideo> chunked; // Set on chunk jobs of a chunked video
+    int chunkIndex = -1;                   // -1 on a chunk job = join only (all chunks checkpointed)
+};
+
+// Scheduler order: previews before full-quality jobs, then cheapest job first so quick photos
+// are not stuck behind long videos, then oldest capture first. Each second a job has waited
+// takes agingRate megapixels off its cost, so in watch mode a long video eventually goes ahead
+// of newer photos instead of waiting forever. The aged cost is taken against a fixed epoch, so
+// the order of two queued jobs does not change while they wait (as the heap requires).
+struct CheaperJobFirst {
+    double agingRate = 0.0; // Megapixels per second of waiting
+
+    bool operator()(const ConversionJob& a, const ConversionJob& b) const {
+        if (a.tier != b.tier) return a.tier > b.tier;
+        const double costA = agedCost(a);
+        const double costB = agedCost(b);
+        if (costA != costB) return costA > costB;
+        return a.metadata->captureTime > b.metadata->captureTime;
+    }
+
+    double agedCost(const ConversionJob& job) const {
+        const double queuedAt = std::chrono::duration<double>(job.createdAt.time_since_epoch()).count();
+        return job.estimatedCost + agingRate * queuedAt;
+    }
 };
 
+// Without duration information (no readable moov), videos are assumed to be ~100 Mbps at 30 fps
+constexpr double kAssumedVideoBytesPerFrame = 100e6 / 8 / 30;
+
 class Insta360BatchProcessor {
 private:
     std::string inputDir;
     std::string outputDir;
     std::string configFile;
-    std::queue<ConversionJob> jobQueue;
+    std::priority_queue<ConversionJob, std::vector<ConversionJob>, CheaperJobFirst> jobQueue;
+    std::set<std::string> knownInputs; // Harvesting, queued or in progress (guarded by queueMutex)
     std::mutex queueMutex;
-    bool running;
+    std::atomic<bool> running; // Read by every worker thread, cleared by stop()
     
     // Configuration
     bool enableGPU = false;
     int outputWidth = 11904;  // Maximum native resolution for Insta360 X4
     int outputHeight = 5952;  // Maximum native resolution (2:1 ratio)
     int bitrate = 50000000; // 50 Mbps
-    int maxConcurrentJobs = 1;
+    int maxConcurrentJobs = 1; // Upper bound when adaptiveConcurrency is on
+    bool adaptiveConcurrency = false; // Adjust running jobs to system pressure and throughput
+    int minConcurrentJobs = 1;
+    int concurrencySampleSeconds = 10;
+    int concurrencyCooldownSeconds = 120;
+    bool concurrencyLogSamples = false; // Log every controller sample (for tuning)
     int watchInterval = 30; // seconds
     bool watchMode = false; // Watch mode: continuously monitor for new files
+    bool enableRenditions = false; // Produce smaller renditions after each photo stitch
+    std::string renditionDir; // Empty = "renditions" folder next to the output
+    std::vector<RenditionSpec> renditions = defaultRenditionLadder();
+    bool enableCubemapTiles = false; // Produce a cubemap tile pyramid after each photo stitch
+    std::string cubemapTileDir; // Empty = "tiles" folder next to the output
+    CubemapTileOptions cubemapTileOptions;
+    int metadataThreads = 2; // Background metadata readers (kept low for NAS disks)
+    double queueAgingMegapixelsPerSecond = 100.0; // Priority a queued job gains per second waited
+    std::string cameraModelsFile; // Optional JSON with extra/corrected camera models
+    CameraModelTable cameraModels; // Loaded from cameraModelsFile before the workers start, then read-only
+    bool chunkedVideo = false; // Stitch long videos as parallel time chunks
+    int chunkSeconds = 120; // Target chunk length (chunks start on a keyframe)
+    bool twoTierConversion = false; // Publish a quick preview before the full-quality stitch
+    int previewWidth = 1920; // Preview size (2:1)
+    int previewBitrate = 4000000; // 4 Mbps preview videos
+    
+    // Declared last: destroyed first, while the queue its callbacks feed still exists
+    std::unique_ptr<ConcurrencyController> concurrency; // Null unless adaptiveConcurrency
+    std::unique_ptr<MetadataHarvester> harvester;
     
 public:
     Insta360BatchProcessor(const std::string& input, const std::string& output, const std::string& config) 
@@ -52,6 +143,27 @@ public:
         
         // Load configuration
         loadConfiguration();
+        jobQueue = decltype(jobQueue)(CheaperJobFirst{std::max(0.0, queueAgingMegapixelsPerSecond)});
+        if (!cameraModelsFile.empty()) {
+            cameraModels = loadCameraModelOverrides(cameraModelsFile);
+        }
+        harvester = std::make_unique<MetadataHarvester>(metadataThreads);
+        if (adaptiveConcurrency) {
+            ConcurrencyOptions options;
+            maxConcurrentJobs = std::max(maxConcurrentJobs, minConcurrentJobs);
+            options.minJobs = minConcurrentJobs;
+            options.maxJobs = maxConcurrentJobs;
+            options.sampleSeconds = concurrencySampleSeconds;
+            options.cooldownSeconds = concurrencyCooldownSeconds;
+            options.logSamples = concurrencyLogSamples;
+            concurrency = std::make_unique<ConcurrencyController>(options, [this] {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                return jobQueue.size();
+            });
+        }
+        if (chunkedVideo && !kSdkHasClipRange) {
+            std::cerr << "Warning: chunkedVideo needs an SDK with clip ranges, videos are stitched whole" << std::endl;
+        }
         
         // Initialize SDK
         ins::InitEnv();
@@ -83,8 +195,39 @@ public:
             if (config.isMember("outputHeight")) outputHeight = config["outputHeight"].asInt();
             if (config.isMember("bitrate")) bitrate = config["bitrate"].asInt();
             if (config.isMember("maxConcurrentJobs")) maxConcurrentJobs = config["maxConcurrentJobs"].asInt();
+            if (config.isMember("adaptiveConcurrency")) adaptiveConcurrency = config["adaptiveConcurrency"].asBool();
+            if (config.isMember("minConcurrentJobs")) minConcurrentJobs = config["minConcurrentJobs"].asInt();
+            if (config.isMember("concurrencySampleSeconds")) concurrencySampleSeconds = config["concurrencySampleSeconds"].asInt();
+            if (config.isMember("concurrencyCooldownSeconds")) concurrencyCooldownSeconds = config["concurrencyCooldownSeconds"].asInt();
+            if (config.isMember("concurrencyLogSamples")) concurrencyLogSamples = config["concurrencyLogSamples"].asBool();
             if (config.isMember("watchInterval")) watchInterval = config["watchInterval"].asInt();
             if (config.isMember("watchMode")) watchMode = config["watchMode"].asBool();
+            if (config.isMember("metadataThreads")) metadataThreads = config["metadataThreads"].asInt();
+            if (config.isMember("queueAgingMegapixelsPerSecond")) queueAgingMegapixelsPerSecond = config["queueAgingMegapixelsPerSecond"].asDouble();
+            if (config.isMember("cameraModelsFile")) cameraModelsFile = config["cameraModelsFile"].asString();
+            if (config.isMember("chunkedVideo")) chunkedVideo = config["chunkedVideo"].asBool();
+            if (config.isMember("chunkSeconds")) chunkSeconds = config["chunkSeconds"].asInt();
+            if (config.isMember("twoTierConversion")) twoTierConversion = config["twoTierConversion"].asBool();
+            if (config.isMember("previewWidth")) previewWidth = config["previewWidth"].asInt();
+            if (config.isMember("previewBitrate")) previewBitrate = config["previewBitrate"].asInt();
+            if (config.isMember("enableRenditions")) enableRenditions = config["enableRenditions"].asBool();
+            if (config.isMember("renditionDir")) renditionDir = config["renditionDir"].asString();
+            if (config.isMember("renditions") && config["renditions"].isArray()) {
+                renditions.clear();
+                for (const auto& entry : config["renditions"]) {
+                    RenditionSpec spec;
+                    spec.name = entry.get("name", "r" + std::to_string(renditions.size())).asString();
+                    spec.width = entry.get("width", 0).asInt();
+                    spec.height = entry.get("height", 0).asInt();
+                    spec.quality = entry.get("quality", 85).asInt();
+                    renditions.push_back(spec);
+                }
+            }
+            if (config.isMember("enableCubemapTiles")) enableCubemapTiles = config["enableCubemapTiles"].asBool();
+            if (config.isMember("cubemapTileDir")) cubemapTileDir = config["cubemapTileDir"].asString();
+            if (config.isMember("cubemapTileSize")) cubemapTileOptions.tileSize = config["cubemapTileSize"].asInt();
+            if (config.isMember("cubemapTileQuality")) cubemapTileOptions.quality = config["cubemapTileQuality"].asInt();
+            if (config.isMember("cubemapTileThreads")) cubemapTileOptions.threads = config["cubemapTileThreads"].asInt();
             
             std::cout << "Configuration loaded from: " << configFile << std::endl;
         } catch (const std::exception& e) {
@@ -100,8 +243,36 @@ public:
         config["outputHeight"] = 5952;  // Maximum native resolution (2:1 ratio)
         config["bitrate"] = 50000000;
         config["maxConcurrentJobs"] = 1;
+        config["adaptiveConcurrency"] = false;  // Set to true to vary jobs between min and max
+        config["minConcurrentJobs"] = 1;
+        config["concurrencySampleSeconds"] = 10;
+        config["concurrencyCooldownSeconds"] = 120;
+        config["concurrencyLogSamples"] = false;  // Set to true to log every sample while tuning
         config["watchInterval"] = 30;
         config["watchMode"] = false;  // Set to true for continuous monitoring
+        config["metadataThreads"] = 2;
+        config["queueAgingMegapixelsPerSecond"] = 100.0;  // 0 = strict cheapest-first order
+        config["cameraModelsFile"] = "";  // Optional JSON with extra camera models
+        config["chunkedVideo"] = false;  // Set to true to stitch long videos as parallel chunks
+        config["chunkSeconds"] = 120;
+        config["twoTierConversion"] = false;  // Set to true to publish a quick preview first
+        config["previewWidth"] = 1920;
+        config["previewBitrate"] = 4000000;
+        config["enableRenditions"] = false;  // Set to true to produce the rendition ladder below
+        config["renditionDir"] = "";  // Empty = "renditions" folder next to the output
+        for (const auto& spec : defaultRenditionLadder()) {
+            Json::Value entry;
+            entry["name"] = spec.name;
+            entry["width"] = spec.width;
+            entry["height"] = spec.height;
+            entry["quality"] = spec.quality;
+            config["renditions"].append(entry);
+        }
+        config["enableCubemapTiles"] = false;  // Set to true to produce web viewer tile pyramids
+        config["cubemapTileDir"] = "";  // Empty = "tiles" folder next to the output
+        config["cubemapTileSize"] = 512;
+        config["cubemapTileQuality"] = 85;
+        config["cubemapTileThreads"] = 0;  // 0 = all cores
         config["comment"] = "Insta360 Batch Processor Configuration - Set watchMode=true for continuous monitoring";
         
         std::ofstream file(configFile);
@@ -111,27 +282,33 @@ public:
         std::cout << "Default configuration created: " << configFile << std::endl;
     }
     
+    // Output of an input: <outputDir>/<stem>.mp4 for videos, .jpg for photos, "" if unsupported.
+    // Every stage (scan, already-converted check, preview, full pass) uses this one path
+    std::string outputPathFor(const fs::path& inputPath) const {
+        std::string extension = inputPath.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".insv") {
+            return (fs::path(outputDir) / (inputPath.stem().string() + ".mp4")).string();
+        }
+        if (extension == ".insp" || extension == ".jpg") {
+            return (fs::path(outputDir) / (inputPath.stem().string() + ".jpg")).string();
+        }
+        return "";
+    }
+    
     // Check if a file has already been converted by looking in the output directory
     bool isAlreadyConverted(const fs::path& inputPath) {
         try {
-            std::string inputFilename = inputPath.stem().string();
-            std::string inputExt = inputPath.extension().string();
-            
-            // Determine expected output extension
-            std::string outputExt;
-            if (inputExt == ".insv") {
-                outputExt = ".mp4";
-            } else if (inputExt == ".insp" || inputExt == ".jpg") {
-                outputExt = ".jpg";
-            } else {
+            const fs::path outputPath = outputPathFor(inputPath);
+            if (outputPath.empty()) {
                 return false; // Unsupported format
             }
             
-            // Get relative path from input directory to maintain folder structure
-            fs::path relativePath = fs::relative(inputPath, inputDir);
-            fs::path outputPath = fs::path(outputDir) / relativePath.parent_path() / (inputFilename + outputExt);
-            
             bool exists = fs::exists(outputPath);
+            if (exists && fs::exists(previewMarkerPath(outputPath.string()))) {
+                std::cout << "Preview only, full quality pending: " << inputPath.filename() << std::endl;
+                return false;
+            }
             if (exists) {
                 std::cout << "File already converted: " << inputPath.filename() << " -> " << outputPath.filename() << std::endl;
             }
@@ -150,6 +327,8 @@ public:
         }
         
         try {
+            // Files found by the same scan have waited equally long
+            const auto scanTime = std::chrono::system_clock::now();
             for (const auto& entry : fs::recursive_directory_iterator(inputDir)) {
                 if (!entry.is_regular_file()) continue;
                 
@@ -157,6 +336,12 @@ public:
                 std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
                 
                 if (extension == ".insv" || extension == ".insp") {
+                    // Skip files already harvesting, queued or being converted
+                    {
+                        std::lock_guard<std::mutex> lock(queueMutex);
+                        if (knownInputs.count(entry.path().string())) continue;
+                    }
+                    
                     // Check if already converted
                     if (isAlreadyConverted(entry.path())) {
                         continue; // Already converted, skip
@@ -166,25 +351,36 @@ public:
                     ConversionJob job;
                     job.inputPath = entry.path().string();
                     job.fileType = extension;
-                    job.createdAt = std::chrono::system_clock::now();
+                    job.createdAt = scanTime;
                     
-                    // Generate output path
-                    std::string outputFileName;
-                    if (extension == ".insv") {
-                        outputFileName = entry.path().stem().string() + ".mp4";
-                    } else {
-                        outputFileName = entry.path().stem().string() + ".jpg";
-                    }
+                    job.outputPath = outputPathFor(entry.path());
                     
-                    job.outputPath = (fs::path(outputDir) / outputFileName).string();
+                    // An existing output here is a preview: only the full-quality pass is left
+                    if (twoTierConversion && !fs::exists(job.outputPath)) {
+                        job.tier = JobTier::Preview;
+                    }
                     
-                    // Add to queue
+                    // Read its metadata in the background; the job is queued once its cost is known
                     {
                         std::lock_guard<std::mutex> lock(queueMutex);
-                        jobQueue.push(job);
+                        knownInputs.insert(job.inputPath);
                     }
-                    
-                    std::cout << "Added to queue: " << entry.path().filename() << " (" << extension << ")" << std::endl;
+                    harvester->submit(job.inputPath, [this, job](std::shared_ptr<const MediaMetadata> metadata) mutable {
+                        job.metadata = std::move(metadata);
+                        try {
+                            job.estimatedCost = estimateCost(job);
+                            std::lock_guard<std::mutex> lock(queueMutex);
+                            jobQueue.push(job);
+                        } catch (const std::exception& e) {
+                            // Forget the file so single runs can finish and the next scan retries it
+                            std::cerr << "Error queuing " << fs::path(job.inputPath).filename() << ": " << e.what() << std::endl;
+                            std::lock_guard<std::mutex> lock(queueMutex);
+                            knownInputs.erase(job.inputPath);
+                            return;
+                        }
+                        std::cout << "Added to queue: " << fs::path(job.inputPath).filename() << " (" << job.fileType
+                                  << (job.tier == JobTier::Preview ? " preview" : "") << ", ~" << static_cast<long long>(job.estimatedCost) << " MP to render)" << std::endl;
+                    });
                 }
             }
         } catch (const std::exception& e) {
@@ -192,62 +388,375 @@ public:
         }
     }
     
+    // Relative cost of a job, used to order the queue
+    double estimateCost(const ConversionJob& job) {
+        const bool preview = job.tier == JobTier::Preview;
+        if (job.fileType == ".insv") {
+            const MediaMetadata& meta = *job.metadata;
+            double frames = meta.durationSeconds * meta.frameRate;
+            if (frames <= 0.0) frames = meta.fileSize / kAssumedVideoBytesPerFrame;
+            int width = std::max(meta.width, 2 * meta.height);
+            width = width > 0 ? std::min(width, outputWidth) : outputWidth;
+            if (preview) width = previewWidth;
+            return frames * (static_cast<double>(width) * width / 2 / 1e6);
+        }
+        if (preview) {
+            return static_cast<double>(previewWidth) * previewWidth / 2 / 1e6;
+        }
+        ResolutionInfo resolution = getResolutionForModel(extractCameraModel(*job.metadata, cameraModels), cameraModels);
+        return static_cast<double>(resolution.width) * resolution.height / 1e6;
+    }
+    
     bool processVideo(const ConversionJob& job) {
         std::cout << "Processing video: " << fs::path(job.inputPath).filename() << std::endl;
         
         try {
-            auto videoStitcher = std::make_shared<ins::VideoStitcher>();
+            // Native size of the clip, capped by the configured output size
+            VideoOutputInfo output = detectVideoOutput(*job.metadata, outputWidth, outputHeight, bitrate, cameraModels);
             
-            std::vector<std::string> inputs = { job.inputPath };
-            videoStitcher->SetInputPath(inputs);
-            videoStitcher->SetOutputPath(job.outputPath);
+            std::string stitchPath = hiddenOutputPath(job.outputPath, "full");
+            if (stitchVideo(job.inputPath, stitchPath, output, nullptr, job.estimatedCost)) {
+                tagSphericalVideo(stitchPath);
+                if (!publishOutput(stitchPath, job)) return false;
+                std::cout << "Video conversion completed: " << fs::path(job.outputPath).filename() << std::endl;
+                return true;
+            } else {
+                std::cerr << "Video conversion failed - output file not created" << std::endl;
+                return false;
+            }
             
-            // Configure for NAS environment
-            videoStitcher->EnableCuda(enableGPU);
-            videoStitcher->EnableFlowState(true);
-            videoStitcher->EnableDirectionLock(true);
-            videoStitcher->EnableH265Encoder();
-            videoStitcher->SetOutputBitRate(bitrate);
-            videoStitcher->SetOutputSize(outputWidth, outputHeight);
-            videoStitcher->SetStitchType(ins::STITCH_TYPE::TEMPLATE); // Use template for reliability
+        } catch (const std::exception& e) {
+            std::cerr << "Error processing video: " << e.what() << std::endl;
+            return false;
+        }
+    }
+    
+    // Stitches a whole video, or only the time range of one chunk, into outputPath
+    // (cost: megapixels to render, reported to the concurrency controller as progress is made)
+    bool stitchVideo(const std::string& inputPath, const std::string& outputPath, const VideoOutputInfo& output,
+                     const VideoChunk* range, double cost) {
+        auto videoStitcher = std::make_shared<ins::VideoStitcher>();
+        
+        std::vector<std::string> inputs = { inputPath };
+        videoStitcher->SetInputPath(inputs);
+        videoStitcher->SetOutputPath(outputPath);
+        
+        // Configure for NAS environment
+        videoStitcher->EnableCuda(enableGPU);
+        videoStitcher->EnableFlowState(true);
+        videoStitcher->EnableDirectionLock(true);
+        videoStitcher->EnableH265Encoder();
+        videoStitcher->SetOutputBitRate(output.bitrate);
+        videoStitcher->SetOutputSize(output.width, output.height);
+        videoStitcher->SetStitchType(ins::STITCH_TYPE::TEMPLATE); // Use template for reliability
+#ifdef INS_HAS_CLIP_RANGE
+        if (range) {
+            videoStitcher->SetClipRange(range->startMs, range->endMs);
+        }
+#else
+        if (range) {
+            // Without clip ranges every chunk would be the whole clip
+            std::cerr << "Error: This SDK cannot stitch a time range of a video" << std::endl;
+            return false;
+        }
+#endif
+        
+        // Set up progress callback
+        std::string label = range ? "Chunk " + std::to_string(range->index) + " progress: " : "Progress: ";
+        videoStitcher->SetStitchProgressCallback([this, label, cost, reported = 0](int progress, int error) mutable {
+            if (error != 0) {
+                std::cerr << "Stitching error: " << error << std::endl;
+            } else {
+                std::cout << label << progress << "%" << std::endl;
+                if (progress > reported) {
+                    reportWork(cost * (progress - reported) / 100.0);
+                    reported = progress;
+                }
+            }
+        });
+        
+        videoStitcher->StartStitch();
+        return fs::exists(outputPath);
+    }
+    
+    // Add 360° video metadata so players and photo libraries show the video as a panorama
+    void tagSphericalVideo(const std::string& path) {
+        if (injectSphericalMetadata(path)) {
+            std::cout << "Added 360° video metadata to " << fs::path(path).filename() << std::endl;
+        } else {
+            std::cerr << "Warning: Failed to add 360° video metadata to " << fs::path(path).filename() << std::endl;
+        }
+    }
+    
+    bool shouldChunk(const ConversionJob& job) const {
+        return chunkedVideo && kSdkHasClipRange && job.metadata->durationSeconds > chunkSeconds * 1.5;
+    }
+    
+    // Plans (or resumes) the chunks of a long video and queues one job per unfinished chunk;
+    // false if the video is to be stitched whole instead
+    bool queueVideoChunks(const ConversionJob& job) {
+        if (!kSdkHasClipRange) {
+            return false; // Stitched whole by a single job
+        }
+        
+        auto state = std::make_shared<ChunkedVideo>();
+        state->chunkDir = job.outputPath + ".chunks";
+        state->output = detectVideoOutput(*job.metadata, outputWidth, outputHeight, bitrate, cameraModels);
+        
+        ChunkPlan plan;
+        plan.source = job.inputPath;
+        plan.sourceSize = job.metadata->fileSize;
+        plan.width = state->output.width;
+        plan.height = state->output.height;
+        plan.bitrate = state->output.bitrate;
+        plan.chunks = planVideoChunks(*job.metadata, chunkSeconds);
+        if (plan.chunks.size() < 2) {
+            return false;
+        }
+        
+        // Chunks checkpointed by an interrupted run are reused if stitched with the same settings
+        std::error_code ec;
+        ChunkPlan previous;
+        if (loadChunkPlan(state->chunkDir, previous) && previous.sameSettings(plan)) {
+            plan = previous;
+        } else {
+            fs::remove_all(state->chunkDir, ec);
+        }
+        fs::create_directories(state->chunkDir, ec);
+        if (!saveChunkPlan(state->chunkDir, plan)) {
+            std::cerr << "Error: Cannot write chunk manifest in " << state->chunkDir << std::endl;
+            return false;
+        }
+        state->plan = plan;
+        
+        std::vector<ConversionJob> chunkJobs;
+        const double totalMs = static_cast<double>(std::max<int64_t>(1, plan.chunks.back().endMs));
+        for (const auto& chunk : plan.chunks) {
+            if (chunk.done) continue;
+            ConversionJob chunkJob = job;
+            chunkJob.chunked = state;
+            chunkJob.chunkIndex = chunk.index;
+            chunkJob.estimatedCost = job.estimatedCost * (chunk.endMs - chunk.startMs) / totalMs;
+            chunkJobs.push_back(chunkJob);
+        }
+        if (chunkJobs.empty()) {
+            // Every chunk is already stitched: only the join is left
+            ConversionJob joinJob = job;
+            joinJob.chunked = state;
+            joinJob.estimatedCost = 0.0;
+            chunkJobs.push_back(joinJob);
+        }
+        state->outstanding = static_cast<int>(chunkJobs.size());
+        
+        std::cout << "🧩 Split " << fs::path(job.inputPath).filename() << " into " << plan.chunks.size()
+                  << " chunks (" << (chunkJobs.front().chunkIndex < 0 ? 0 : chunkJobs.size()) << " to stitch)" << std::endl;
+        
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& chunkJob : chunkJobs) {
+            jobQueue.push(std::move(chunkJob));
+        }
+        return true;
+    }
+    
+    // Stitches one chunk; returns true once the whole video is finished (joined or failed)
+    bool processVideoChunk(const ConversionJob& job, bool& success) {
+        ChunkedVideo& state = *job.chunked;
+        bool chunkOk = true;
+        
+        if (job.chunkIndex >= 0) {
+            VideoChunk chunk;
+            size_t chunkCount;
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                chunk = state.plan.chunks[job.chunkIndex];
+                chunkCount = state.plan.chunks.size();
+            }
+            std::cout << "Processing video chunk " << chunk.index + 1 << "/" << chunkCount << " of "
+                      << fs::path(job.inputPath).filename() << " (" << chunk.startMs / 1000.0 << "s - "
+                      << chunk.endMs / 1000.0 << "s)" << std::endl;
             
-            // Set up progress callback
-            videoStitcher->SetStitchProgressCallback([](int progress, int error) {
-                if (error != 0) {
-                    std::cerr << "Stitching error: " << error << std::endl;
+            // Stitched under a temporary name so only complete segments are ever checkpointed
+            std::string segment = chunkSegmentPath(state.chunkDir, chunk.index);
+            std::string partial = segment + ".part.mp4";
+            std::error_code ec;
+            try {
+                chunkOk = stitchVideo(job.inputPath, partial, state.output, &chunk, job.estimatedCost);
+                if (chunkOk) {
+                    fs::rename(partial, segment, ec);
+                    chunkOk = !ec;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error processing video chunk: " << e.what() << std::endl;
+                chunkOk = false;
+            }
+            if (!chunkOk) {
+                fs::remove(partial, ec); // Never left behind for the next run
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (job.chunkIndex >= 0) {
+                if (chunkOk) {
+                    state.plan.chunks[job.chunkIndex].done = true;
+                    saveChunkPlan(state.chunkDir, state.plan);
                 } else {
-                    std::cout << "Progress: " << progress << "%" << std::endl;
+                    state.failed = true;
                 }
-            });
+            }
+            if (--state.outstanding > 0) {
+                return false;
+            }
+        }
+        
+        // Last chunk to finish: join the segments
+        if (state.failed) {
+            std::cerr << "Video chunks failed, completed chunks are kept for the next run" << std::endl;
+            success = false;
+            return true;
+        }
+        success = joinVideoChunks(job, state);
+        return true;
+    }
+    
+    bool joinVideoChunks(const ConversionJob& job, ChunkedVideo& state) {
+        std::vector<std::string> segments;
+        for (const auto& chunk : state.plan.chunks) {
+            segments.push_back(chunkSegmentPath(state.chunkDir, chunk.index));
+        }
+        
+        std::error_code ec;
+        std::string tempPath = hiddenOutputPath(job.outputPath, "full");
+        if (!concatenateMp4(segments, tempPath)) {
+            std::cerr << "Failed to join video chunks of " << fs::path(job.inputPath).filename() << std::endl;
+            fs::remove(tempPath, ec);
+            return false;
+        }
+        tagSphericalVideo(tempPath); // moov is at the end: only it is rewritten
+        if (!publishOutput(tempPath, job)) {
+            return false;
+        }
+        fs::remove_all(state.chunkDir, ec);
+        
+        std::cout << "Video conversion completed: " << fs::path(job.outputPath).filename() << " ("
+                  << segments.size() << " chunks joined)" << std::endl;
+        return true;
+    }
+    
+    // Quick low-resolution pass (TEMPLATE, no fusion), published where the full output will go
+    bool processPreview(const ConversionJob& job) {
+        std::cout << "Processing preview: " << fs::path(job.inputPath).filename() << std::endl;
+        
+        const int width = previewWidth;
+        const int height = previewWidth / 2;
+        std::string stitchPath = hiddenOutputPath(job.outputPath, "preview");
+        
+        try {
+            bool stitched = false;
+            if (job.fileType == ".insv") {
+                VideoOutputInfo output{width, height, previewBitrate, ""};
+                stitched = stitchVideo(job.inputPath, stitchPath, output, nullptr, job.estimatedCost);
+                if (stitched) tagSphericalVideo(stitchPath);
+            } else {
+                auto imageStitcher = std::make_shared<ins::ImageStitcher>();
+                std::vector<std::string> inputs = { job.inputPath };
+                imageStitcher->SetInputPath(inputs);
+                imageStitcher->SetOutputPath(stitchPath);
+                imageStitcher->EnableCuda(enableGPU);
+                imageStitcher->SetImageProcessingAccelType(ins::ImageProcessingAccel::kCPU);
+                imageStitcher->SetStitchType(ins::STITCH_TYPE::TEMPLATE);
+                imageStitcher->EnableStitchFusion(false);
+                imageStitcher->SetOutputSize(width, height);
+                stitched = imageStitcher->Stitch() && fs::exists(stitchPath);
+                if (stitched) {
+                    reportWork(job.estimatedCost);
+                    add360ExifMetadata(stitchPath, *job.metadata, width, height);
+                }
+            }
             
-            videoStitcher->StartStitch();
+            if (!stitched) {
+                std::cerr << "Preview failed: " << fs::path(job.inputPath).filename() << std::endl;
+                return false;
+            }
             
-            if (fs::exists(job.outputPath)) {
-                std::cout << "Video conversion completed: " << fs::path(job.outputPath).filename() << std::endl;
-                return true;
-            } else {
-                std::cerr << "Video conversion failed - output file not created" << std::endl;
+            // Marker first: an interrupted run must never take the preview for the final output
+            std::error_code ec;
+            const std::string marker = previewMarkerPath(job.outputPath);
+            std::ofstream markerFile(marker);
+            markerFile.close();
+            if (!markerFile.good()) {
+                std::cerr << "Cannot write preview marker " << fs::path(marker).filename()
+                          << ", preview not published" << std::endl;
+                fs::remove(stitchPath, ec);
                 return false;
             }
+            fs::rename(stitchPath, job.outputPath, ec);
+            if (ec) {
+                // Nothing published: the marker alone does not hide a missing output from the next scan
+                std::cerr << "Failed to publish preview " << fs::path(job.outputPath).filename() << ": "
+                          << ec.message() << std::endl;
+                fs::remove(stitchPath, ec);
+                fs::remove(marker, ec);
+                return false;
+            }
+            std::cout << "👀 Preview ready: " << fs::path(job.outputPath).filename() << std::endl;
+            return true;
             
         } catch (const std::exception& e) {
-            std::cerr << "Error processing video: " << e.what() << std::endl;
+            std::cerr << "Error processing preview: " << e.what() << std::endl;
             return false;
         }
     }
     
+    // Queues the full-quality pass of a file whose preview has been processed
+    void queueFullPass(const ConversionJob& preview) {
+        ConversionJob job = preview;
+        job.tier = JobTier::Full;
+        job.estimatedCost = estimateCost(job);
+        
+        std::lock_guard<std::mutex> lock(queueMutex);
+        jobQueue.push(job);
+    }
+    
+    // Hidden file next to the output, e.g. ".VID_001.full.mp4", renamed into place when complete
+    static std::string hiddenOutputPath(const std::string& outputPath, const std::string& tier) {
+        fs::path path(outputPath);
+        return (path.parent_path() / ("." + path.stem().string() + "." + tier + path.extension().string())).string();
+    }
+    
+    // Marks an output that is still a preview: ".VID_001.preview"
+    static std::string previewMarkerPath(const std::string& outputPath) {
+        fs::path path(outputPath);
+        return (path.parent_path() / ("." + path.stem().string() + ".preview")).string();
+    }
+    
+    // Atomically replaces the output (possibly a preview) with the full-quality file
+    bool publishOutput(const std::string& stitchedPath, const ConversionJob& job) {
+        std::error_code ec;
+        fs::rename(stitchedPath, job.outputPath, ec);
+        if (ec) {
+            std::cerr << "Failed to move " << fs::path(stitchedPath).filename() << " to " << job.outputPath
+                      << ": " << ec.message() << std::endl;
+            return false;
+        }
+        fs::remove(previewMarkerPath(job.outputPath), ec);
+        return true;
+    }
+    
     bool processImage(const ConversionJob& job) {
         std::cout << "Processing image: " << fs::path(job.inputPath).filename() << std::endl;
         
         try {
             // 🔍 DYNAMIC RESOLUTION DETECTION per file
-            ResolutionInfo resolution = detectOptimalResolution(job.inputPath);
+            ResolutionInfo resolution = detectOptimalResolution(*job.metadata, cameraModels);
             
             auto imageStitcher = std::make_shared<ins::ImageStitcher>();
             
+            // Stitched under a hidden name and renamed, so a preview is replaced atomically
+            std::string stitchPath = hiddenOutputPath(job.outputPath, "full");
             std::vector<std::string> inputs = { job.inputPath };
             imageStitcher->SetInputPath(inputs);
-            imageStitcher->SetOutputPath(job.outputPath);
+            imageStitcher->SetOutputPath(stitchPath);
             
             // Configure for NAS environment with optimal stitching quality
             imageStitcher->EnableCuda(enableGPU);
@@ -268,17 +777,43 @@ public:
             
             bool success = imageStitcher->Stitch();
             
-            if (success && fs::exists(job.outputPath)) {
-                std::cout << "Image conversion completed: " << fs::path(job.outputPath).filename() << std::endl;
+            if (success && fs::exists(stitchPath)) {
+                reportWork(job.estimatedCost);
                 
                 // Add 360° EXIF metadata to make the image recognizable as a panorama
                 std::cout << "Adding 360° EXIF metadata..." << std::endl;
-                if (add360ExifMetadata(job.outputPath, job.inputPath, resolution.width, resolution.height)) {
+                if (add360ExifMetadata(stitchPath, *job.metadata, resolution.width, resolution.height)) {
                     std::cout << "Successfully added 360° EXIF metadata to " << fs::path(job.outputPath).filename() << std::endl;
                 } else {
                     std::cerr << "Warning: Failed to add 360° EXIF metadata to " << fs::path(job.outputPath).filename() << std::endl;
                 }
                 
+                if (!publishOutput(stitchPath, job)) {
+                    return false;
+                }
+                std::cout << "Image conversion completed: " << fs::path(job.outputPath).filename() << std::endl;
+                
+                if (enableRenditions) {
+                    generateJobRenditions(job);
+                }
+                
+                if (enableCubemapTiles) {
+                    std::string baseDir = cubemapTileDir.empty()
+                        ? (fs::path(job.outputPath).parent_path() / "tiles").string()
+                        : cubemapTileDir;
+                    std::string tileDir = (fs::path(baseDir) / fs::path(job.outputPath).stem()).string();
+                    // The photo is already published: a tiling failure never fails the job
+                    bool tiled = false;
+                    try {
+                        tiled = generateCubemapTiles(job.outputPath, tileDir, cubemapTileOptions).success;
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error generating cubemap tiles: " << e.what() << std::endl;
+                    }
+                    if (!tiled) {
+                        std::cerr << "Warning: Failed to generate cubemap tiles for " << fs::path(job.outputPath).filename() << std::endl;
+                    }
+                }
+                
                 return true;
             } else {
                 std::cerr << "Image conversion failed" << std::endl;
@@ -291,17 +826,43 @@ public:
         }
     }
     
+    // Decode the stitched output once and write every configured rendition
+    void generateJobRenditions(const ConversionJob& job) {
+        std::string targetDir = renditionDir.empty()
+            ? (fs::path(job.outputPath).parent_path() / "renditions").string()
+            : renditionDir;
+        
+        // Metadata is written by the rendition encoder, with each rendition's own pano size
+        generateRenditions(job.outputPath, targetDir, renditions, [&](int width, int height) {
+            return build360MetadataSegments(*job.metadata, width, height);
+        });
+    }
+    
+    // Feeds the adaptive concurrency controller with rendered megapixels: videos as their
+    // progress callback advances, photos (no progress from ImageStitcher) once stitched
+    void reportWork(double megapixels) {
+        if (concurrency) {
+            concurrency->reportWork(megapixels);
+        }
+    }
+    
     // markAsProcessed function removed - we now detect processed files by checking output directory
     
-    void processJobs() {
+    void processJobs(int worker) {
         while (running) {
+            // Workers above the adaptive limit idle (a lowered limit lets running jobs finish)
+            if (concurrency && worker >= concurrency->activeLimit()) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            
             ConversionJob job;
             bool hasJob = false;
             
             {
                 std::lock_guard<std::mutex> lock(queueMutex);
                 if (!jobQueue.empty()) {
-                    job = jobQueue.front();
+                    job = jobQueue.top();
                     jobQueue.pop();
                     hasJob = true;
                 }
@@ -309,18 +870,47 @@ public:
             
             if (hasJob) {
                 bool success = false;
+                if (concurrency) {
+                    concurrency->jobStarted();
+                }
+                
+                // Parse the input's metadata once; every stage below reuses this snapshot
+                if (!job.metadata) {
+                    job.metadata = std::make_shared<MediaMetadata>(readMediaMetadata(job.inputPath));
+                }
                 
-                if (job.fileType == ".insv") {
+                bool finished = true; // False while other chunks of the same video are outstanding
+                if (job.chunked) {
+                    finished = processVideoChunk(job, success);
+                } else if (job.tier == JobTier::Preview) {
+                    // The full-quality pass follows even if the preview failed
+                    processPreview(job);
+                    queueFullPass(job);
+                    finished = false;
+                } else if (job.fileType == ".insv" && shouldChunk(job) && queueVideoChunks(job)) {
+                    finished = false; // Its chunk jobs finish the input
+                } else if (job.fileType == ".insv") {
                     success = processVideo(job);
                 } else if (job.fileType == ".insp") {
                     success = processImage(job);
                 }
+                if (concurrency) {
+                    concurrency->jobFinished();
+                }
+                
+                if (!finished) {
+                    continue;
+                }
                 
                 if (success) {
                     std::cout << "Job completed successfully: " << fs::path(job.inputPath).filename() << std::endl;
                 } else {
                     std::cerr << "Job failed: " << fs::path(job.inputPath).filename() << std::endl;
                 }
+                
+                // Failed files are picked up again by the next scan
+                std::lock_guard<std::mutex> lock(queueMutex);
+                knownInputs.erase(job.inputPath);
             } else {
                 // No jobs, wait a bit
                 std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -340,8 +930,12 @@ public:
             std::cout << "The processor will scan once, convert all found files, and exit." << std::endl;
         }
         
-        // Start worker thread
-        std::thread worker(&Insta360BatchProcessor::processJobs, this);
+        // Start worker threads (chunks of one video can run on any of them)
+        // With adaptiveConcurrency, maxConcurrentJobs workers exist but only the first activeLimit() take jobs
+        std::vector<std::thread> workers;
+        for (int i = 0; i < std::max(1, maxConcurrentJobs); ++i) {
+            workers.emplace_back(&Insta360BatchProcessor::processJobs, this, i);
+        }
         
         if (watchMode) {
             // Watch mode: continuous monitoring
@@ -351,8 +945,8 @@ public:
                 // Display queue status
                 {
                     std::lock_guard<std::mutex> lock(queueMutex);
-                    if (!jobQueue.empty()) {
-                        std::cout << "Jobs in queue: " << jobQueue.size() << std::endl;
+                    if (!knownInputs.empty()) {
+                        std::cout << "Jobs pending: " << knownInputs.size() << " (" << jobQueue.size() << " queued)" << std::endl;
                     }
                 }
                 
@@ -366,7 +960,7 @@ public:
             // Display initial queue status
             {
                 std::lock_guard<std::mutex> lock(queueMutex);
-                std::cout << "Jobs in queue: " << jobQueue.size() << std::endl;
+                std::cout << "Jobs found: " << knownInputs.size() << " (metadata being read in the background)" << std::endl;
             }
             
             // Wait for all jobs to complete
@@ -374,8 +968,9 @@ public:
             while (!allJobsCompleted && running) {
                 std::this_thread::sleep_for(std::chrono::seconds(2));
                 
+                // Inputs leave knownInputs once fully converted (or failed), after every chunk
                 std::lock_guard<std::mutex> lock(queueMutex);
-                allJobsCompleted = jobQueue.empty();
+                allJobsCompleted = knownInputs.empty();
             }
             
             // Stop the processor after completion
@@ -383,7 +978,9 @@ public:
             std::cout << "All jobs completed. Exiting single run mode." << std::endl;
         }
         
-        worker.join();
+        for (auto& worker : workers) {
+            worker.join();
+        }
     }
     
     void stop() {
@@ -0,0 +1,202 @@
+#include "concurrency_controller.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Throughput measured this long ago no longer says much about the current mix of jobs
+constexpr std::chrono::minutes kThroughputMemory(30);
+
+// Reads the avg10 values of the "some" and "full" lines of one /proc/pressure file
+bool readPressureFile(const char* path, double& some, double& full) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    bool found = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        double avg10 = 0.0;
+        if (std::sscanf(line.c_str(), "some avg10=%lf", &avg10) == 1) {
+            some = avg10;
+            found = true;
+        } else if (std::sscanf(line.c_str(), "full avg10=%lf", &avg10) == 1) {
+            full = avg10;
+        }
+    }
+    return found;
+}
+
+std::string describe(const PressureSample& pressure, double throughput, size_t pending) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+    if (pressure.available) {
+        text << "cpu " << pressure.cpuSome << "%, mem " << pressure.memorySome << "%/" << pressure.memoryFull
+             << "%, io " << pressure.ioSome << "%/" << pressure.ioFull << "%, ";
+    }
+    text << throughput << " MP/s, " << pending << " queued";
+    return text.str();
+}
+
+// Throughput recorded for a job count, "-" if unknown
+std::string describeLevel(double throughput) {
+    if (throughput < 0.0) return "-";
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << throughput;
+    return text.str();
+}
+
+} // namespace
+
+PressureSample readPressure() {
+    PressureSample sample;
+    double unused = 0.0;
+    sample.available = readPressureFile("/proc/pressure/cpu", sample.cpuSome, unused) &&
+                       readPressureFile("/proc/pressure/memory", sample.memorySome, sample.memoryFull) &&
+                       readPressureFile("/proc/pressure/io", sample.ioSome, sample.ioFull);
+    return sample;
+}
+
+ConcurrencyController::ConcurrencyController(const ConcurrencyOptions& options, PendingJobs pendingJobs)
+    : options_(options), pendingJobs_(std::move(pendingJobs)) {
+    options_.minJobs = std::max(1, options_.minJobs);
+    options_.maxJobs = std::max(options_.minJobs, options_.maxJobs);
+    options_.sampleSeconds = std::max(1, options_.sampleSeconds);
+    limit_ = options_.minJobs; // Start low, climb while the NAS keeps up
+    limitSince_ = Clock::now();
+
+    std::cout << "⚖️ Adaptive concurrency: " << options_.minJobs << "-" << options_.maxJobs
+              << " jobs, starting at " << limit_.load() << std::endl;
+    thread_ = std::thread(&ConcurrencyController::run, this);
+}
+
+ConcurrencyController::~ConcurrencyController() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void ConcurrencyController::reportWork(double megapixels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    workSince_ += megapixels;
+}
+
+void ConcurrencyController::jobStarted() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++busyWorkers_;
+    maxBusyWorkers_ = std::max(maxBusyWorkers_, busyWorkers_);
+}
+
+void ConcurrencyController::jobFinished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --busyWorkers_;
+    minBusyWorkers_ = std::min(minBusyWorkers_, busyWorkers_);
+}
+
+void ConcurrencyController::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, std::chrono::seconds(options_.sampleSeconds), [this] { return stopping_; })) {
+        lock.unlock();
+        sample();
+        lock.lock();
+    }
+}
+
+void ConcurrencyController::sample() {
+    const PressureSample pressure = readPressure();
+    const size_t pending = pendingJobs_();
+    const auto now = Clock::now();
+    const int limit = limit_.load();
+
+    if (!pressure.available && !psiWarned_) {
+        std::cerr << "Warning: /proc/pressure not available, concurrency follows throughput only" << std::endl;
+        psiWarned_ = true;
+    }
+
+    // Only saturated intervals (every active worker busy the whole time, none beyond the limit)
+    // measure the limit; the queue length only tells whether another worker would find work
+    double work;
+    bool saturated;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        work = workSince_;
+        workSince_ = 0.0;
+        saturated = minBusyWorkers_ >= limit && maxBusyWorkers_ <= limit;
+        minBusyWorkers_ = busyWorkers_;
+        maxBusyWorkers_ = busyWorkers_;
+    }
+    if (saturated) {
+        busyWork_ += work;
+        busySeconds_ += options_.sampleSeconds;
+    }
+    const double throughput = busySeconds_ > 0.0 ? busyWork_ / busySeconds_ : 0.0;
+    const bool measured = busySeconds_ >= options_.cooldownSeconds && busyWork_ > 0.0;
+    if (measured) {
+        throughputAtLimit_[limit] = {throughput, now};
+    }
+
+    auto known = [&](int level) {
+        auto it = throughputAtLimit_.find(level);
+        if (it == throughputAtLimit_.end() || now - it->second.at > kThroughputMemory) return -1.0;
+        return it->second.megapixelsPerSecond;
+    };
+
+    const bool highPressure = pressure.available &&
+        (pressure.memorySome > options_.highMemorySome || pressure.ioFull > options_.highIoFull ||
+         pressure.cpuSome > options_.highCpuSome);
+    const bool lowPressure = !pressure.available ||
+        (pressure.memorySome < options_.lowMemorySome && pressure.ioSome < options_.lowIoSome &&
+         pressure.cpuSome < options_.lowCpuSome);
+    const double below = known(limit - 1);
+    const double above = known(limit + 1);
+
+    const char* reason = nullptr;
+    int vote = 0;
+    if (limit > options_.minJobs && highPressure) {
+        vote = -1;
+        reason = "high pressure";
+    } else if (limit > options_.minJobs && measured && below > throughput * 1.05) {
+        vote = -1;
+        reason = "faster with fewer jobs";
+    } else if (limit < options_.maxJobs && lowPressure && pending > 0 &&
+               (above < 0.0 || (measured && above > throughput * 1.05))) {
+        vote = 1;
+        reason = "low pressure, work waiting";
+    }
+
+    lowerVotes_ = vote < 0 ? lowerVotes_ + 1 : 0;
+    raiseVotes_ = vote > 0 ? raiseVotes_ + 1 : 0;
+
+    if (options_.logSamples) {
+        std::cout << "⚖️ Sample at " << limit << " jobs: " << describe(pressure, throughput, pending)
+                  << (measured ? "" : " (not measured yet)") << "; " << limit - 1 << " jobs: "
+                  << describeLevel(below) << " MP/s, " << limit + 1 << " jobs: " << describeLevel(above)
+                  << " MP/s; votes -" << lowerVotes_ << "/+" << raiseVotes_ << std::endl;
+    }
+
+    // Stalls on memory or I/O get worse with time: high pressure does not wait for the cooldown
+    const bool cooledDown = now - limitSince_ >= std::chrono::seconds(options_.cooldownSeconds);
+    if (lowerVotes_ >= options_.samplesToChange && (cooledDown || highPressure)) {
+        changeLimit(limit - 1, reason, describe(pressure, throughput, pending));
+    } else if (raiseVotes_ >= options_.samplesToChange && cooledDown) {
+        changeLimit(limit + 1, reason, describe(pressure, throughput, pending));
+    }
+}
+
+void ConcurrencyController::changeLimit(int limit, const char* reason, const std::string& metrics) {
+    std::cout << "⚖️ Concurrency " << limit_.load() << " → " << limit << ": " << reason << " (" << metrics << ")"
+              << std::endl;
+    limit_ = limit;
+    limitSince_ = Clock::now();
+    busyWork_ = 0.0;
+    busySeconds_ = 0.0;
+    raiseVotes_ = 0;
+    lowerVotes_ = 0;
+}
@@ -0,0 +1,114 @@
+#ifndef CONCURRENCY_CONTROLLER_H
+#define CONCURRENCY_CONTROLLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Linux pressure stall information: share of time (avg10, in %) tasks were stalled
+struct PressureSample {
+    bool available = false; // False on kernels without PSI (before 4.20 or disabled)
+    double cpuSome = 0.0;
+    double memorySome = 0.0;
+    double memoryFull = 0.0;
+    double ioSome = 0.0;
+    double ioFull = 0.0;
+};
+
+/**
+ * Reads /proc/pressure/{cpu,memory,io}.
+ * @return sample with available = false if PSI is not supported
+ */
+PressureSample readPressure();
+
+struct ConcurrencyOptions {
+    int minJobs = 1;
+    int maxJobs = 4;
+    int sampleSeconds = 10;    // Time between two samples
+    int samplesToChange = 3;   // Consecutive samples agreeing before a change
+    int cooldownSeconds = 120; // Minimum time between two changes (lets throughput settle)
+    bool logSamples = false;   // Debug: log the metrics of every sample, not only the changes
+
+    // Lower when stalls exceed any of these (avg10 %): swapping or disk-bound stitches
+    double highMemorySome = 20.0;
+    double highIoFull = 30.0;
+    double highCpuSome = 90.0;
+    // Raise only while every value stays below these
+    double lowMemorySome = 5.0;
+    double lowIoSome = 20.0;
+    double lowCpuSome = 50.0;
+};
+
+/**
+ * Feedback controller for the number of stitch jobs running at once.
+ *
+ * Workers report the megapixels they render as they go, and when they start and finish a job. Throughput
+ * is only measured over intervals where exactly `limit` jobs ran the whole time: an idle worker would
+ * understate it, jobs still draining after a lowered limit would overstate it. Every sample the
+ * controller reads PSI and the queue length, and moves the active limit one step within [minJobs, maxJobs]:
+ * - down when memory, I/O or CPU stalls are high, or when the level below rendered faster;
+ * - up when pressure is low, work is waiting and the level above did not render slower.
+ * A change needs several agreeing samples in a row and a cooldown since the last one.
+ * Without PSI, decisions rely on throughput alone. Every decision is logged with its metrics.
+ */
+class ConcurrencyController {
+public:
+    using PendingJobs = std::function<size_t()>;
+
+    ConcurrencyController(const ConcurrencyOptions& options, PendingJobs pendingJobs);
+    ~ConcurrencyController();
+
+    ConcurrencyController(const ConcurrencyController&) = delete;
+    ConcurrencyController& operator=(const ConcurrencyController&) = delete;
+
+    // Workers with an index at or above this limit stay idle
+    int activeLimit() const { return limit_.load(); }
+
+    // Called by workers as they render, with the output megapixels done since their last report
+    void reportWork(double megapixels);
+
+    // Called by workers around each job, so only intervals with every active worker busy are measured
+    void jobStarted();
+    void jobFinished();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void sample();
+    void changeLimit(int limit, const char* reason, const std::string& metrics);
+
+    ConcurrencyOptions options_;
+    PendingJobs pendingJobs_;
+    std::atomic<int> limit_;
+
+    struct Measurement {
+        double megapixelsPerSecond;
+        Clock::time_point at;
+    };
+
+    // Throughput of each limit, measured over the saturated time it was active
+    std::map<int, Measurement> throughputAtLimit_;
+    Clock::time_point limitSince_;
+    double busyWork_ = 0.0;    // Megapixels and seconds of saturated samples since limitSince_
+    double busySeconds_ = 0.0;
+    double workSince_ = 0.0;   // Megapixels reported since the last sample (guarded by mutex_)
+    int busyWorkers_ = 0;      // Jobs running now, and the fewest/most since the last sample (mutex_)
+    int minBusyWorkers_ = 0;
+    int maxBusyWorkers_ = 0;
+    int raiseVotes_ = 0;
+    int lowerVotes_ = 0;
+    bool psiWarned_ = false;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+#endif // CONCURRENCY_CONTROLLER_H
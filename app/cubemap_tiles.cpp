@@ -0,0 +1,316 @@
+#include "cubemap_tiles.h"
+#include "jpeg_io.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <json/json.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+struct RgbImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Faces sharing a geometry only differ by a longitude offset (side faces)
+enum class FaceGeometry { Side, Up, Down };
+
+struct CubeFace {
+    const char* name;
+    FaceGeometry geometry;
+    int quarterTurns;  // Longitude offset in 90° steps (side faces)
+};
+
+// Marzipano face names; "u" has its bottom edge on "f", "d" has its top edge on "f"
+constexpr CubeFace kFaces[] = {
+    {"f", FaceGeometry::Side, 0},
+    {"r", FaceGeometry::Side, 1},
+    {"b", FaceGeometry::Side, 2},
+    {"l", FaceGeometry::Side, 3},
+    {"u", FaceGeometry::Up, 0},
+    {"d", FaceGeometry::Down, 0},
+};
+
+// Source coordinates (in pixels of the sampled mip) of every face pixel of one level, built
+// once per level. The side faces share one table (u only depends on the column), and the
+// down face is the up face mirrored vertically, so it reads the up table.
+struct LevelLut {
+    int faceSize = 0;
+    std::vector<float> sideU;  // Per column
+    std::vector<float> sideV;  // Per pixel
+    std::vector<float> upU;    // Per pixel
+    std::vector<float> upV;
+};
+
+struct TileTask {
+    int tileX;
+    int tileY;
+};
+
+// Runs body(i) for i in [0, count) on up to threadCount threads
+template <typename Body>
+void parallelFor(size_t count, int threadCount, Body body) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) body(i);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min<int>(threadCount, static_cast<int>(count)); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+RgbImage downsample2x(const RgbImage& src) {
+    RgbImage dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 3);
+
+    const size_t srcStride = static_cast<size_t>(src.width) * 3;
+    for (int y = 0; y < dst.height; ++y) {
+        const uint8_t* row0 = &src.pixels[srcStride * std::min(2 * y, src.height - 1)];
+        const uint8_t* row1 = &src.pixels[srcStride * std::min(2 * y + 1, src.height - 1)];
+        uint8_t* out = &dst.pixels[static_cast<size_t>(dst.width) * 3 * y];
+        for (int x = 0; x < dst.width; ++x) {
+            const int x0 = std::min(2 * x, src.width - 1) * 3;
+            const int x1 = std::min(2 * x + 1, src.width - 1) * 3;
+            for (int c = 0; c < 3; ++c) {
+                out[3 * x + c] = static_cast<uint8_t>(
+                    (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+void allocateLevelLut(LevelLut& lut, int faceSize) {
+    const size_t pixels = static_cast<size_t>(faceSize) * faceSize;
+    lut.faceSize = faceSize;
+    lut.sideU.assign(faceSize, 0.0f);
+    lut.sideV.assign(pixels, 0.0f);
+    lut.upU.assign(pixels, 0.0f);
+    lut.upV.assign(pixels, 0.0f);
+}
+
+// Fills one row of the level tables
+void buildLevelLutRow(LevelLut& lut, int row, const RgbImage& src) {
+    const int faceSize = lut.faceSize;
+    const double b = 2.0 * (row + 0.5) / faceSize - 1.0;
+    const size_t offset = static_cast<size_t>(row) * faceSize;
+    auto toU = [&](double lon) { return static_cast<float>((lon / (2.0 * kPi) + 0.5) * src.width - 0.5); };
+    auto toV = [&](double lat) { return static_cast<float>((0.5 - lat / kPi) * src.height - 0.5); };
+
+    for (int i = 0; i < faceSize; ++i) {
+        const double a = 2.0 * (i + 0.5) / faceSize - 1.0;
+        if (row == 0) lut.sideU[i] = toU(std::atan(a));
+        lut.sideV[offset + i] = toV(std::atan2(-b, std::sqrt(1.0 + a * a)));
+        lut.upU[offset + i] = toU(std::atan2(a, b));
+        lut.upV[offset + i] = toV(std::atan2(1.0, std::hypot(a, b)));
+    }
+}
+
+// Renders one tile of a face: bilinear sampling through the level tables; longitude wraps,
+// latitude clamps
+void renderTile(const LevelLut& lut, const CubeFace& face, int x0, int y0, int width, int height,
+                const RgbImage& src, uint8_t* out) {
+    const int w = src.width;
+    const int h = src.height;
+    const int faceSize = lut.faceSize;
+    const size_t stride = static_cast<size_t>(w) * 3;
+    const float uOffset = face.quarterTurns * w / 4.0f;
+
+    for (int j = 0; j < height; ++j) {
+        const int y = y0 + j;
+        for (int i = 0; i < width; ++i, out += 3) {
+            const int x = x0 + i;
+            float u, v;
+            switch (face.geometry) {
+                case FaceGeometry::Side:
+                    u = lut.sideU[x] + uOffset;
+                    v = lut.sideV[static_cast<size_t>(y) * faceSize + x];
+                    break;
+                case FaceGeometry::Up:
+                    u = lut.upU[static_cast<size_t>(y) * faceSize + x];
+                    v = lut.upV[static_cast<size_t>(y) * faceSize + x];
+                    break;
+                default: {
+                    // Down: same longitude as the mirrored up pixel, opposite latitude
+                    const size_t mirrored = static_cast<size_t>(faceSize - 1 - y) * faceSize + x;
+                    u = lut.upU[mirrored];
+                    v = h - 1 - lut.upV[mirrored];
+                    break;
+                }
+            }
+
+            const float uf = std::floor(u);
+            const float vf = std::floor(v);
+            const float fx = u - uf;
+            const float fy = v - vf;
+
+            int xa = static_cast<int>(uf) % w;
+            if (xa < 0) xa += w;
+            const int xb = (xa + 1 == w) ? 0 : xa + 1;
+            const int ya = std::clamp(static_cast<int>(vf), 0, h - 1);
+            const int yb = std::clamp(static_cast<int>(vf) + 1, 0, h - 1);
+
+            const uint8_t* p00 = &src.pixels[stride * ya + 3 * xa];
+            const uint8_t* p01 = &src.pixels[stride * ya + 3 * xb];
+            const uint8_t* p10 = &src.pixels[stride * yb + 3 * xa];
+            const uint8_t* p11 = &src.pixels[stride * yb + 3 * xb];
+
+            for (int c = 0; c < 3; ++c) {
+                const float top = p00[c] + (p01[c] - p00[c]) * fx;
+                const float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+                out[c] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+}
+
+} // namespace
+
+CubemapTileResult generateCubemapTiles(const std::string& sourcePath,
+                                       const std::string& outputDir,
+                                       const CubemapTileOptions& options) {
+    CubemapTileResult result;
+    result.directory = outputDir;
+
+    std::vector<RgbImage> mips(1);
+    if (!readJpegRgb(sourcePath, mips[0].pixels, mips[0].width, mips[0].height)) {
+        return result;
+    }
+
+    const int tileSize = std::max(16, options.tileSize);
+
+    // Face sizes, most detailed first: a side face spans a quarter of the equirectangular width
+    std::vector<int> levelSizes;
+    for (int size = std::max(tileSize, mips[0].width / 4); ; size = (size + 1) / 2) {
+        levelSizes.push_back(size);
+        if (size <= tileSize) break;
+    }
+    std::reverse(levelSizes.begin(), levelSizes.end());  // Level 0 = smallest
+
+    // Pick for each level the smallest mip that still has at least one source pixel per face pixel
+    std::vector<int> levelMip(levelSizes.size(), 0);
+    for (size_t level = 0; level < levelSizes.size(); ++level) {
+        const double ratio = (mips[0].width / 4.0) / levelSizes[level];
+        levelMip[level] = ratio >= 2.0 ? static_cast<int>(std::floor(std::log2(ratio))) : 0;
+    }
+    const int mipCount = *std::max_element(levelMip.begin(), levelMip.end()) + 1;
+    while (static_cast<int>(mips.size()) < mipCount) {
+        mips.push_back(downsample2x(mips.back()));
+    }
+
+    std::cout << "🧊 Generating cubemap tiles: " << levelSizes.size() << " levels, face size "
+              << levelSizes.back() << "px, tile " << tileSize << "px" << std::endl;
+
+    // Create the directory tree up front so workers only write files
+    for (size_t level = 0; level < levelSizes.size(); ++level) {
+        const int tilesPerSide = (levelSizes[level] + tileSize - 1) / tileSize;
+        for (const auto& face : kFaces) {
+            for (int ty = 0; ty < tilesPerSide; ++ty) {
+                const fs::path dir = fs::path(outputDir) / std::to_string(level) / face.name / std::to_string(ty);
+                std::error_code ec;
+                fs::create_directories(dir, ec);
+                if (ec) {
+                    std::cerr << "Error: Cannot create tile directory " << dir << ": " << ec.message() << std::endl;
+                    return result;
+                }
+            }
+        }
+    }
+
+    int threadCount = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threadCount = std::max(1, threadCount);
+
+    // One level at a time: its tables are built once, shared by every tile, then released
+    std::atomic<int> tilesWritten{0};
+    std::atomic<bool> failed{false};
+    LevelLut lut;
+    for (size_t level = 0; level < levelSizes.size() && !failed; ++level) {
+        const int faceSize = levelSizes[level];
+        const RgbImage& src = mips[levelMip[level]];
+        allocateLevelLut(lut, faceSize);
+        parallelFor(faceSize, threadCount, [&](size_t row) { buildLevelLutRow(lut, static_cast<int>(row), src); });
+
+        const int tilesPerSide = (faceSize + tileSize - 1) / tileSize;
+        std::vector<TileTask> tasks;
+        for (int ty = 0; ty < tilesPerSide; ++ty) {
+            for (int tx = 0; tx < tilesPerSide; ++tx) {
+                tasks.push_back({tx, ty});
+            }
+        }
+
+        parallelFor(tasks.size(), threadCount, [&](size_t index) {
+            if (failed) return;
+            const TileTask& task = tasks[index];
+            const int x0 = task.tileX * tileSize;
+            const int y0 = task.tileY * tileSize;
+            const int width = std::min(tileSize, faceSize - x0);
+            const int height = std::min(tileSize, faceSize - y0);
+            std::vector<uint8_t> tile(static_cast<size_t>(width) * height * 3);
+
+            for (const auto& face : kFaces) {
+                renderTile(lut, face, x0, y0, width, height, src, tile.data());
+                const fs::path path = fs::path(outputDir) / std::to_string(level) / face.name /
+                                      std::to_string(task.tileY) / (std::to_string(task.tileX) + ".jpg");
+                if (!writeJpegRgb(path.string(), tile.data(), width, height, options.quality)) {
+                    failed = true;
+                    return;
+                }
+                ++tilesWritten;
+            }
+        });
+    }
+    lut = LevelLut();
+
+    if (failed) {
+        std::cerr << "Error: Cubemap tile generation failed for " << sourcePath << std::endl;
+        return result;
+    }
+
+    Json::Value descriptor;
+    descriptor["type"] = "cubemap";
+    descriptor["source"] = fs::path(sourcePath).filename().string();
+    descriptor["tileSize"] = tileSize;
+    descriptor["faceSize"] = levelSizes.back();
+    descriptor["urlTemplate"] = "{z}/{f}/{y}/{x}.jpg";
+    for (const auto& face : kFaces) {
+        descriptor["faces"].append(face.name);
+    }
+    for (int size : levelSizes) {
+        Json::Value level;
+        level["tileSize"] = tileSize;
+        level["size"] = size;
+        descriptor["levels"].append(level);
+    }
+
+    std::ofstream file(fs::path(outputDir) / "tiles.json");
+    file << descriptor;
+    file.close();
+    if (!file) {
+        std::cerr << "Error: Cannot write the tile descriptor in " << outputDir << std::endl;
+        return result;
+    }
+
+    result.success = true;
+    result.faceSize = levelSizes.back();
+    result.levels = static_cast<int>(levelSizes.size());
+    result.tileCount = tilesWritten;
+    std::cout << "Cubemap tiles written: " << result.tileCount << " tiles in " << outputDir << std::endl;
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef CUBEMAP_TILES_H
+#define CUBEMAP_TILES_H
+
+#include <string>
+
+// Settings of the cubemap tile pyramid
+struct CubemapTileOptions {
+    int tileSize = 512;  // Tile edge in pixels
+    int quality = 85;    // JPEG quality of each tile
+    int threads = 0;     // Worker threads (0 = hardware concurrency)
+};
+
+// Summary of a generated pyramid
+struct CubemapTileResult {
+    bool success = false;
+    std::string directory;
+    int faceSize = 0;   // Face edge of the most detailed level
+    int levels = 0;
+    int tileCount = 0;
+};
+
+/**
+ * Converts a stitched equirectangular JPEG into a multi-resolution cubemap tile pyramid
+ * for web 360° viewers (Marzipano layout):
+ *
+ *   <outputDir>/<z>/<face>/<y>/<x>.jpg   z = level (0 = smallest), face in f r b l u d
+ *   <outputDir>/tiles.json               descriptor (tile size, face size of every level)
+ *
+ * The source is decoded once; lower levels sample a 2x box-filtered mip of the source so
+ * they do not alias. Levels are rendered one after the other: the projection lookup tables
+ * of a level are built once and shared by all its tiles and faces (the four side faces
+ * only differ by a longitude offset, the down face mirrors the up face), and tiles are
+ * rendered by a thread pool and written to disk as soon as they are encoded.
+ *
+ * Memory is not bounded by the tiles: the whole decoded source and its mips stay resident
+ * (about 4 bytes per source pixel, ~290 MB for a 72 MP photo), plus the tables of the level
+ * being rendered (12 bytes per face pixel, about half the decoded source at the most
+ * detailed level) and one tile per thread.
+ * The descriptor is written last, its presence marks a complete pyramid.
+ *
+ * @param sourcePath Path to the stitched equirectangular JPEG
+ * @param outputDir Directory receiving the pyramid (created if needed)
+ * @param options Tile size, JPEG quality and thread count
+ */
+CubemapTileResult generateCubemapTiles(const std::string& sourcePath,
+                                       const std::string& outputDir,
+                                       const CubemapTileOptions& options = CubemapTileOptions());
+
+#endif // CUBEMAP_TILES_H
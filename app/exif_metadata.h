@@ -2,6 +2,9 @@
 #define EXIF_METADATA_H
 
 #include <string>
+#include <vector>
+#include "jpeg_metadata.h"
+#include "media_metadata.h"
 
 /**
  * Adds 360° EXIF metadata to an image file to make it recognized as a 360° panorama
@@ -14,12 +17,23 @@
  * - CroppedAreaImageWidthPixels = image width (same as FullPanoWidthPixels)
  * - CroppedAreaImageHeightPixels = image height (same as FullPanoHeightPixels)
  * 
+ * The metadata is spliced into the JPEG header with a single sequential copy of the file
+ * (see spliceJpegMetadata). The original's tags come from its metadata snapshot, so the
+ * source file is not parsed again. Tags already in the converted file (e.g. written by the
+ * stitcher) are kept unless set here, as are its other XMP properties.
+ * 
  * @param imagePath Path to the converted image file to modify
- * @param originalPath Path to the original source file (.insp) to copy metadata from
+ * @param original Metadata snapshot of the original source file (.insp) to copy metadata from
  * @param width Width of the converted image in pixels
  * @param height Height of the converted image in pixels
  * @return true if metadata was successfully added, false otherwise
  */
-bool add360ExifMetadata(const std::string& imagePath, const std::string& originalPath, int width, int height);
+bool add360ExifMetadata(const std::string& imagePath, const MediaMetadata& original, int width, int height);
+
+/**
+ * Builds the APP1 EXIF and XMP segments written by add360ExifMetadata, so encoders that
+ * produce their own JPEGs (renditions) can emit them while writing the file.
+ */
+std::vector<JpegSegment> build360MetadataSegments(const MediaMetadata& original, int width, int height);
 
 #endif // EXIF_METADATA_H
\ No newline at end of file
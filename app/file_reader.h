@@ -0,0 +1,71 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only access to a file by offset (pread) into buffers owned by the caller, so header
+ * and box parsing of multi-gigabyte files only reads the bytes it needs.
+ *
+ * Inputs on the watch folder can be truncated or replaced while they are read (a copy still
+ * in progress or restarted). Unlike a memory mapping, which raises SIGBUS past the new end of
+ * file, a short read here is just a failed read of that one file.
+ */
+class FileReader {
+public:
+    explicit FileReader(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return;
+
+        struct stat st{};
+        if (::fstat(fd_, &st) == 0 && st.st_size > 0) size_ = static_cast<uint64_t>(st.st_size);
+    }
+
+    ~FileReader() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    bool opened() const { return fd_ >= 0; }
+    uint64_t size() const { return size_; }  // Size when opened
+
+    // True once a read came back short or failed: the file changed while it was read
+    bool failed() const { return failed_; }
+
+    // Reads exactly size bytes at offset, false on a short read or an I/O error
+    bool read(uint64_t offset, void* buffer, size_t size) const {
+        uint8_t* out = static_cast<uint8_t*>(buffer);
+        while (size > 0) {
+            const ssize_t count = ::pread(fd_, out, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                failed_ = true;
+                return false;
+            }
+            out += count;
+            offset += static_cast<uint64_t>(count);
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    bool read(uint64_t offset, size_t size, std::vector<uint8_t>& buffer) const {
+        buffer.resize(size);
+        return read(offset, buffer.data(), size);
+    }
+
+private:
+    int fd_ = -1;
+    uint64_t size_ = 0;
+    mutable bool failed_ = false;
+};
+
+#endif // FILE_READER_H
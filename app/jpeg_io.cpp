@@ -0,0 +1,107 @@
+#include "jpeg_io.h"
+#include <iostream>
+
+namespace {
+
+void jpegLongjmpErrorExit(j_common_ptr cinfo) {
+    // pub is the first member, so libjpeg's pointer is the manager's address
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    std::longjmp(err->jump, 1);
+}
+
+} // namespace
+
+jpeg_error_mgr* initJpegErrorManager(JpegErrorManager& err) {
+    jpeg_error_mgr* pub = jpeg_std_error(&err.pub);
+    pub->error_exit = jpegLongjmpErrorExit;
+    return pub;
+}
+
+bool readJpegRgb(const std::string& path, std::vector<uint8_t>& pixels, int& width, int& height) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Error: Cannot open JPEG file: " << path << std::endl;
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo{};
+    JpegErrorManager jerr;
+    cinfo.err = initJpegErrorManager(jerr);
+
+    bool success = false;
+    try {
+        jpegCall(jerr, [&] {
+            jpeg_create_decompress(&cinfo);
+            jpeg_stdio_src(&cinfo, file);
+            jpeg_read_header(&cinfo, TRUE);
+            cinfo.out_color_space = JCS_RGB;
+            jpeg_start_decompress(&cinfo);
+        });
+
+        width = static_cast<int>(cinfo.output_width);
+        height = static_cast<int>(cinfo.output_height);
+        const size_t stride = static_cast<size_t>(width) * 3;
+        pixels.resize(stride * height);
+        uint8_t* data = pixels.data();
+
+        jpegCall(jerr, [&] {
+            while (cinfo.output_scanline < cinfo.output_height) {
+                JSAMPROW row = data + stride * cinfo.output_scanline;
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
+        });
+        success = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error decoding " << path << ": " << e.what() << std::endl;
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    std::fclose(file);
+    return success;
+}
+
+bool writeJpegRgb(const std::string& path, const uint8_t* pixels, int width, int height,
+                  int quality, size_t stride) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Cannot create JPEG file: " << path << std::endl;
+        return false;
+    }
+    if (stride == 0) {
+        stride = static_cast<size_t>(width) * 3;
+    }
+
+    jpeg_compress_struct cinfo{};
+    JpegErrorManager jerr;
+    cinfo.err = initJpegErrorManager(jerr);
+
+    bool success = false;
+    try {
+        jpegCall(jerr, [&] {
+            jpeg_create_compress(&cinfo);
+            jpeg_stdio_dest(&cinfo, file);
+            cinfo.image_width = width;
+            cinfo.image_height = height;
+            cinfo.input_components = 3;
+            cinfo.in_color_space = JCS_RGB;
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, quality, TRUE);
+            jpeg_start_compress(&cinfo, TRUE);
+
+            while (cinfo.next_scanline < cinfo.image_height) {
+                JSAMPROW row = const_cast<JSAMPROW>(pixels + stride * cinfo.next_scanline);
+                jpeg_write_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_compress(&cinfo);
+        });
+        success = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error encoding " << path << ": " << e.what() << std::endl;
+    }
+
+    jpeg_destroy_compress(&cinfo);
+    if (std::fclose(file) != 0) success = false;
+    return success;
+}
@@ -0,0 +1,54 @@
+#ifndef JPEG_IO_H
+#define JPEG_IO_H
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <jpeglib.h>
+
+/**
+ * libjpeg error manager that returns control to the caller instead of calling exit().
+ * libjpeg reports fatal errors from inside its own C frames, which a C++ exception must
+ * not unwind through; error_exit records the message and longjmps back to jpegCall.
+ */
+struct JpegErrorManager {
+    jpeg_error_mgr pub{};
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX] = {};
+};
+
+/**
+ * Initializes the error manager and returns the pointer to store in cinfo.err.
+ */
+jpeg_error_mgr* initJpegErrorManager(JpegErrorManager& err);
+
+/**
+ * Runs libjpeg calls and turns a libjpeg error into a std::runtime_error once back in
+ * C++ code. The longjmp skips fn's own frame, so fn must only call libjpeg and must not
+ * hold objects with destructors; everything else belongs outside of it.
+ */
+template <typename Fn>
+void jpegCall(JpegErrorManager& err, Fn&& fn) {
+    if (setjmp(err.jump) != 0) {
+        throw std::runtime_error(std::string("libjpeg: ") + err.message);
+    }
+    fn();
+}
+
+/**
+ * Decodes a whole JPEG file into an interleaved RGB buffer.
+ * @return true on success, false (with a message on stderr) otherwise
+ */
+bool readJpegRgb(const std::string& path, std::vector<uint8_t>& pixels, int& width, int& height);
+
+/**
+ * Encodes an interleaved RGB buffer to a JPEG file.
+ * @param stride Bytes between the starts of two rows (0 = width * 3)
+ */
+bool writeJpegRgb(const std::string& path, const uint8_t* pixels, int width, int height,
+                  int quality, size_t stride = 0);
+
+#endif // JPEG_IO_H
@@ -0,0 +1,442 @@
+#include "jpeg_metadata.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint16_t kExifIfdPointer = 0x8769;
+constexpr uint16_t kGpsIfdPointer = 0x8825;
+
+const char kExifHeader[] = {'E', 'x', 'i', 'f', 0, 0};
+const char kXmpNamespace[] = "http://ns.adobe.com/xap/1.0/";
+
+void putU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+size_t paddedSize(size_t size) {
+    return (size + 1) & ~static_cast<size_t>(1);
+}
+
+size_t ifdSize(const std::vector<ExifEntry>& entries) {
+    size_t size = 2 + 12 * entries.size() + 4;
+    for (const auto& entry : entries) {
+        if (entry.data.size() > 4) size += paddedSize(entry.data.size());
+    }
+    return size;
+}
+
+// Appends one IFD located at "offset" (from the TIFF header); out-of-line values follow it
+void writeIfd(std::vector<uint8_t>& tiff, const std::vector<ExifEntry>& entries, uint32_t offset) {
+    uint32_t dataOffset = offset + static_cast<uint32_t>(2 + 12 * entries.size() + 4);
+    std::vector<uint8_t> dataArea;
+
+    putU16(tiff, static_cast<uint16_t>(entries.size()));
+    for (const auto& entry : entries) {
+        putU16(tiff, entry.tag);
+        putU16(tiff, entry.type);
+        putU32(tiff, entry.count);
+        if (entry.data.size() <= 4) {
+            std::vector<uint8_t> inlineValue(entry.data);
+            inlineValue.resize(4, 0);
+            tiff.insert(tiff.end(), inlineValue.begin(), inlineValue.end());
+        } else {
+            putU32(tiff, dataOffset + static_cast<uint32_t>(dataArea.size()));
+            dataArea.insert(dataArea.end(), entry.data.begin(), entry.data.end());
+            if (dataArea.size() % 2) dataArea.push_back(0);
+        }
+    }
+    putU32(tiff, 0);  // No next IFD
+    tiff.insert(tiff.end(), dataArea.begin(), dataArea.end());
+}
+
+ExifEntry makeLongEntry(ExifIfd ifd, uint16_t tag, uint32_t value) {
+    ExifEntry entry{ifd, tag, kExifLong, 1, {}};
+    putU32(entry.data, value);
+    return entry;
+}
+
+void writeSegment(FILE* out, const JpegSegment& segment) {
+    const size_t length = segment.payload.size() + 2;
+    const uint8_t header[4] = {0xFF, segment.marker, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length & 0xFF)};
+    std::fwrite(header, 1, sizeof(header), out);
+    std::fwrite(segment.payload.data(), 1, segment.payload.size(), out);
+}
+
+bool startsWith(const std::vector<uint8_t>& payload, const char* prefix, size_t length) {
+    return payload.size() >= length && std::memcmp(payload.data(), prefix, length) == 0;
+}
+
+size_t typeSize(uint16_t type) {
+    switch (type) {
+        case 1: case 2: case 6: case 7: return 1;  // BYTE, ASCII, SBYTE, UNDEFINED
+        case 3: case 8: return 2;                  // SHORT, SSHORT
+        case 4: case 9: case 11: return 4;         // LONG, SLONG, FLOAT
+        case 5: case 10: case 12: return 8;        // RATIONAL, SRATIONAL, DOUBLE
+        default: return 0;
+    }
+}
+
+// Values that are offsets into the original TIFF structure: they would dangle once rewritten
+bool isOffsetTag(ExifIfd ifd, uint16_t tag) {
+    if (ifd == ExifIfd::Image) {
+        return tag == 0x0111 || tag == 0x0117 || tag == 0x014A || tag == 0x0201 || tag == 0x0202;
+    }
+    return ifd == ExifIfd::Photo && (tag == 0xA005 || tag == 0x927C);  // Interoperability IFD, MakerNote
+}
+
+// Bounds-checked view of a TIFF structure in either byte order
+class TiffView {
+public:
+    TiffView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool init() {
+        if (size_ < 8) return false;
+        if (data_[0] == 'I' && data_[1] == 'I') little_ = true;
+        else if (data_[0] == 'M' && data_[1] == 'M') little_ = false;
+        else return false;
+        return u16(2) == 42;
+    }
+
+    bool contains(size_t offset, size_t length) const {
+        return offset <= size_ && length <= size_ - offset;
+    }
+
+    uint16_t u16(size_t offset) const {
+        if (!contains(offset, 2)) return 0;
+        const uint8_t* p = data_ + offset;
+        return little_ ? static_cast<uint16_t>(p[0] | (p[1] << 8)) : static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t u32(size_t offset) const {
+        if (!contains(offset, 4)) return 0;
+        const uint8_t* p = data_ + offset;
+        return little_ ? (static_cast<uint32_t>(p[0]) | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24))
+                       : ((static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | static_cast<uint32_t>(p[3]));
+    }
+
+    const uint8_t* at(size_t offset) const { return data_ + offset; }
+    bool little() const { return little_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    bool little_ = true;
+};
+
+void parseIfd(const TiffView& tiff, uint32_t offset, ExifIfd ifd, std::vector<ExifEntry>& entries) {
+    if (!tiff.contains(offset, 2)) return;
+    const uint16_t count = tiff.u16(offset);
+
+    for (uint16_t i = 0; i < count; ++i) {
+        const size_t entryOffset = offset + 2 + 12 * static_cast<size_t>(i);
+        if (!tiff.contains(entryOffset, 12)) return;
+
+        const uint16_t tag = tiff.u16(entryOffset);
+        const uint16_t type = tiff.u16(entryOffset + 2);
+        const uint32_t components = tiff.u32(entryOffset + 4);
+        const size_t elementSize = typeSize(type);
+        if (elementSize == 0 || components > (1u << 20)) continue;
+
+        const size_t valueSize = elementSize * components;
+        const size_t valueOffset = valueSize <= 4 ? entryOffset + 8 : tiff.u32(entryOffset + 8);
+        if (!tiff.contains(valueOffset, valueSize)) continue;
+
+        if (ifd == ExifIfd::Image && tag == kExifIfdPointer) {
+            parseIfd(tiff, tiff.u32(entryOffset + 8), ExifIfd::Photo, entries);
+            continue;
+        }
+        if (ifd == ExifIfd::Image && tag == kGpsIfdPointer) {
+            parseIfd(tiff, tiff.u32(entryOffset + 8), ExifIfd::GPS, entries);
+            continue;
+        }
+        if (isOffsetTag(ifd, tag)) continue;
+
+        // Normalize to little-endian, component by component (rationals are two LONGs)
+        ExifEntry entry{ifd, tag, type, components, std::vector<uint8_t>(tiff.at(valueOffset), tiff.at(valueOffset) + valueSize)};
+        const size_t componentSize = (type == 5 || type == 10) ? 4 : elementSize;
+        if (!tiff.little() && componentSize > 1) {
+            for (size_t p = 0; p + componentSize <= entry.data.size(); p += componentSize) {
+                std::reverse(entry.data.begin() + p, entry.data.begin() + p + componentSize);
+            }
+        }
+        entries.push_back(std::move(entry));
+    }
+}
+
+bool isExifSegment(const JpegSegment& segment) {
+    return segment.marker == 0xE1 && startsWith(segment.payload, kExifHeader, sizeof(kExifHeader));
+}
+
+bool isXmpSegment(const JpegSegment& segment) {
+    return segment.marker == 0xE1 && startsWith(segment.payload, kXmpNamespace, sizeof(kXmpNamespace));
+}
+
+// Existing tags first, so the update overrides them (buildExifSegment keeps the last occurrence)
+JpegSegment mergeExifSegments(const JpegSegment& existing, const JpegSegment& update) {
+    std::vector<ExifEntry> entries;
+    parseExifSegment(existing.payload.data(), existing.payload.size(), entries);
+    const size_t existingCount = entries.size();
+    if (!parseExifSegment(update.payload.data(), update.payload.size(), entries) || existingCount == 0) {
+        return update;
+    }
+    return buildExifSegment(entries);
+}
+
+// Adds the update's rdf:Description to the existing packet. A GPano description written by an
+// earlier conversion is dropped first; a packet with GPano tags in any other form is replaced
+JpegSegment mergeXmpSegments(const JpegSegment& existing, const JpegSegment& update) {
+    std::string packet(existing.payload.begin() + sizeof(kXmpNamespace), existing.payload.end());
+    const std::string addition(update.payload.begin() + sizeof(kXmpNamespace), update.payload.end());
+    const size_t previous = packet.find("xmlns:GPano=");
+    if (previous != std::string::npos) {
+        const size_t from = packet.rfind("<rdf:Description", previous);
+        const size_t to = packet.find("/>", previous);
+        if (from != std::string::npos && to != std::string::npos && packet.find('>', from) == to + 1) {
+            packet.erase(from, to + 2 - from);
+        }
+    }
+    const size_t insertAt = packet.rfind("</rdf:RDF>");
+    const size_t begin = addition.find("<rdf:Description");
+    const size_t end = addition.find("/>", begin);
+    if (packet.find("GPano:") != std::string::npos || insertAt == std::string::npos ||
+        begin == std::string::npos || end == std::string::npos) {
+        return update;
+    }
+
+    JpegSegment merged{0xE1, {}};
+    merged.payload.assign(kXmpNamespace, kXmpNamespace + sizeof(kXmpNamespace));
+    merged.payload.insert(merged.payload.end(), packet.begin(), packet.begin() + insertAt);
+    merged.payload.insert(merged.payload.end(), addition.begin() + begin, addition.begin() + end + 2);
+    merged.payload.insert(merged.payload.end(), packet.begin() + insertAt, packet.end());
+    return merged.payload.size() + 2 > 0xFFFF ? update : merged;
+}
+
+} // namespace
+
+bool parseExifSegment(const uint8_t* payload, size_t size, std::vector<ExifEntry>& entries) {
+    if (size < sizeof(kExifHeader) || std::memcmp(payload, kExifHeader, sizeof(kExifHeader)) != 0) return false;
+    TiffView tiff(payload + sizeof(kExifHeader), size - sizeof(kExifHeader));
+    if (!tiff.init()) return false;
+    parseIfd(tiff, tiff.u32(4), ExifIfd::Image, entries);
+    return true;
+}
+
+ExifEntry makeAsciiEntry(ExifIfd ifd, uint16_t tag, const std::string& value) {
+    ExifEntry entry{ifd, tag, kExifAscii, static_cast<uint32_t>(value.size() + 1), {}};
+    entry.data.assign(value.begin(), value.end());
+    entry.data.push_back(0);
+    return entry;
+}
+
+ExifEntry makeShortEntry(ExifIfd ifd, uint16_t tag, uint16_t value) {
+    ExifEntry entry{ifd, tag, kExifShort, 1, {}};
+    putU16(entry.data, value);
+    return entry;
+}
+
+JpegSegment buildExifSegment(const std::vector<ExifEntry>& entries) {
+    // Later entries override earlier ones; std::map keeps each directory sorted by tag
+    std::map<std::pair<ExifIfd, uint16_t>, ExifEntry> unique;
+    for (const auto& entry : entries) {
+        if (entry.tag == kExifIfdPointer || entry.tag == kGpsIfdPointer) continue;
+        unique.insert_or_assign({entry.ifd, entry.tag}, entry);
+    }
+
+    std::vector<ExifEntry> image, photo, gps;
+    for (const auto& [key, entry] : unique) {
+        switch (key.first) {
+            case ExifIfd::Image: image.push_back(entry); break;
+            case ExifIfd::Photo: photo.push_back(entry); break;
+            case ExifIfd::GPS: gps.push_back(entry); break;
+        }
+    }
+
+    // Pointer entries have fixed sizes, so every offset is known before writing
+    if (!photo.empty()) image.push_back(makeLongEntry(ExifIfd::Image, kExifIfdPointer, 0));
+    if (!gps.empty()) image.push_back(makeLongEntry(ExifIfd::Image, kGpsIfdPointer, 0));
+    std::sort(image.begin(), image.end(), [](const ExifEntry& a, const ExifEntry& b) { return a.tag < b.tag; });
+
+    const uint32_t imageOffset = 8;
+    const uint32_t photoOffset = imageOffset + static_cast<uint32_t>(ifdSize(image));
+    const uint32_t gpsOffset = photoOffset + static_cast<uint32_t>(photo.empty() ? 0 : ifdSize(photo));
+    for (auto& entry : image) {
+        if (entry.tag == kExifIfdPointer) entry = makeLongEntry(ExifIfd::Image, kExifIfdPointer, photoOffset);
+        if (entry.tag == kGpsIfdPointer) entry = makeLongEntry(ExifIfd::Image, kGpsIfdPointer, gpsOffset);
+    }
+
+    std::vector<uint8_t> tiff = {'I', 'I', 42, 0};
+    putU32(tiff, imageOffset);
+    writeIfd(tiff, image, imageOffset);
+    if (!photo.empty()) writeIfd(tiff, photo, photoOffset);
+    if (!gps.empty()) writeIfd(tiff, gps, gpsOffset);
+
+    JpegSegment segment{0xE1, {}};
+    segment.payload.assign(kExifHeader, kExifHeader + sizeof(kExifHeader));
+    segment.payload.insert(segment.payload.end(), tiff.begin(), tiff.end());
+    return segment;
+}
+
+JpegSegment buildPanoramaXmpSegment(int width, int height) {
+    const std::string w = std::to_string(width);
+    const std::string h = std::to_string(height);
+    const std::string packet =
+        "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>"
+        "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+        "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+        "<rdf:Description rdf:about=\"\" xmlns:GPano=\"http://ns.google.com/photos/1.0/panorama/\""
+        " GPano:ProjectionType=\"equirectangular\""
+        " GPano:UsePanoramaViewer=\"True\""
+        " GPano:StitchingSoftware=\"Insta360 SDK\""
+        " GPano:FullPanoWidthPixels=\"" + w + "\""
+        " GPano:FullPanoHeightPixels=\"" + h + "\""
+        " GPano:CroppedAreaImageWidthPixels=\"" + w + "\""
+        " GPano:CroppedAreaImageHeightPixels=\"" + h + "\""
+        " GPano:CroppedAreaLeftPixels=\"0\""
+        " GPano:CroppedAreaTopPixels=\"0\"/>"
+        "</rdf:RDF>"
+        "</x:xmpmeta>"
+        "<?xpacket end=\"w\"?>";
+
+    JpegSegment segment{0xE1, {}};
+    segment.payload.assign(kXmpNamespace, kXmpNamespace + sizeof(kXmpNamespace));  // Includes the NUL
+    segment.payload.insert(segment.payload.end(), packet.begin(), packet.end());
+    return segment;
+}
+
+bool spliceJpegMetadata(const std::string& path, const std::vector<JpegSegment>& updates) {
+    FILE* in = std::fopen(path.c_str(), "rb");
+    if (!in) {
+        std::cerr << "Error: Cannot open JPEG file: " << path << std::endl;
+        return false;
+    }
+
+    const std::string tmpPath = path + ".meta.tmp";
+    FILE* out = nullptr;
+    bool success = false;
+
+    do {
+        uint8_t soi[2];
+        if (std::fread(soi, 1, 2, in) != 2 || soi[0] != 0xFF || soi[1] != 0xD8) {
+            std::cerr << "Error: Not a JPEG file: " << path << std::endl;
+            break;
+        }
+
+        // Parse the header segments up to SOS
+        std::vector<JpegSegment> header;
+        bool foundSos = false;
+        bool valid = true;
+        while (true) {
+            int c = std::fgetc(in);
+            if (c != 0xFF) { valid = false; break; }
+            while ((c = std::fgetc(in)) == 0xFF) {}  // Fill bytes
+            if (c == EOF) { valid = false; break; }
+
+            uint8_t lengthBytes[2];
+            if (std::fread(lengthBytes, 1, 2, in) != 2) { valid = false; break; }
+            const size_t length = (static_cast<size_t>(lengthBytes[0]) << 8) | lengthBytes[1];
+            if (length < 2) { valid = false; break; }
+
+            JpegSegment segment{static_cast<uint8_t>(c), std::vector<uint8_t>(length - 2)};
+            if (std::fread(segment.payload.data(), 1, segment.payload.size(), in) != segment.payload.size()) {
+                valid = false;
+                break;
+            }
+            foundSos = (c == 0xDA);
+            header.push_back(std::move(segment));
+            if (foundSos) break;
+        }
+        if (!valid || !foundSos) {
+            std::cerr << "Error: Malformed JPEG header: " << path << std::endl;
+            break;
+        }
+
+        // Merge into the metadata already in the file (e.g. written by the stitcher)
+        const JpegSegment* existingExif = nullptr;
+        const JpegSegment* existingXmp = nullptr;
+        for (const auto& segment : header) {
+            if (!existingExif && isExifSegment(segment)) existingExif = &segment;
+            if (!existingXmp && isXmpSegment(segment)) existingXmp = &segment;
+        }
+        std::vector<JpegSegment> segments;
+        bool replacesExif = false;
+        bool replacesXmp = false;
+        for (const auto& update : updates) {
+            replacesExif = replacesExif || isExifSegment(update);
+            replacesXmp = replacesXmp || isXmpSegment(update);
+            if (existingExif && isExifSegment(update)) {
+                segments.push_back(mergeExifSegments(*existingExif, update));
+            } else if (existingXmp && isXmpSegment(update)) {
+                segments.push_back(mergeXmpSegments(*existingXmp, update));
+            } else {
+                segments.push_back(update);
+            }
+        }
+        const bool fits = std::all_of(segments.begin(), segments.end(),
+                                      [](const JpegSegment& segment) { return segment.payload.size() + 2 <= 0xFFFF; });
+        if (!fits) {
+            std::cerr << "Error: Metadata segment too large for a JPEG marker" << std::endl;
+            break;
+        }
+
+        out = std::fopen(tmpPath.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: Cannot create temporary file: " << tmpPath << std::endl;
+            break;
+        }
+
+        std::fwrite(soi, 1, 2, out);
+        size_t next = 0;
+        if (!header.empty() && header[0].marker == 0xE0 && startsWith(header[0].payload, "JFIF", 5)) {
+            writeSegment(out, header[0]);
+            next = 1;
+        }
+        for (const auto& segment : segments) {
+            writeSegment(out, segment);
+        }
+        for (; next < header.size(); ++next) {
+            const JpegSegment& segment = header[next];
+            // Only the kinds of segment this update merged into are replaced
+            if (!(replacesExif && isExifSegment(segment)) && !(replacesXmp && isXmpSegment(segment))) {
+                writeSegment(out, segment);
+            }
+        }
+
+        // Entropy-coded data and trailer: one sequential copy
+        std::vector<char> buffer(1 << 20);
+        size_t bytes;
+        while ((bytes = std::fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+            if (std::fwrite(buffer.data(), 1, bytes, out) != bytes) break;
+        }
+        success = !std::ferror(in) && !std::ferror(out);
+    } while (false);
+
+    std::fclose(in);
+    if (out) {
+        success = (std::fclose(out) == 0) && success;
+    }
+
+    std::error_code ec;
+    if (success) {
+        fs::rename(tmpPath, path, ec);
+        success = !ec;
+    }
+    if (!success) {
+        fs::remove(tmpPath, ec);
+    }
+    return success;
+}
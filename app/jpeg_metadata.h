@@ -0,0 +1,77 @@
+#ifndef JPEG_METADATA_H
+#define JPEG_METADATA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// EXIF directory a tag belongs to
+enum class ExifIfd { Image, Photo, GPS };
+
+// TIFF field types used by EXIF
+enum ExifType : uint16_t {
+    kExifByte = 1,
+    kExifAscii = 2,
+    kExifShort = 3,
+    kExifLong = 4,
+    kExifRational = 5,
+    kExifUndefined = 7,
+    kExifSLong = 9,
+    kExifSRational = 10,
+};
+
+// One EXIF tag ready to be serialized; data holds the value in little-endian byte order
+struct ExifEntry {
+    ExifIfd ifd;
+    uint16_t tag;
+    uint16_t type;
+    uint32_t count;
+    std::vector<uint8_t> data;
+};
+
+// One JPEG marker segment (payload excludes the 0xFF marker and the length field)
+struct JpegSegment {
+    uint8_t marker;  // e.g. 0xE1 for APP1
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Parses an APP1 "Exif" payload into entries of the IFD0, Exif and GPS directories, values
+ * normalized to little-endian. Tags holding offsets into the original TIFF structure
+ * (MakerNote, Interoperability IFD, strips, SubIFDs) and the thumbnail IFD are left out.
+ * @return false if the payload is not a readable EXIF segment
+ */
+bool parseExifSegment(const uint8_t* payload, size_t size, std::vector<ExifEntry>& entries);
+
+ExifEntry makeAsciiEntry(ExifIfd ifd, uint16_t tag, const std::string& value);
+ExifEntry makeShortEntry(ExifIfd ifd, uint16_t tag, uint16_t value);
+
+/**
+ * Builds an APP1 "Exif" segment (little-endian TIFF with IFD0, Exif and GPS directories).
+ * Entries with the same directory and tag keep the last occurrence.
+ */
+JpegSegment buildExifSegment(const std::vector<ExifEntry>& entries);
+
+/**
+ * Builds an APP1 XMP segment holding the Google Photo Sphere (GPano) tags for a full
+ * equirectangular panorama of the given size.
+ */
+JpegSegment buildPanoramaXmpSegment(int width, int height);
+
+/**
+ * Writes EXIF and XMP APP1 segments into a JPEG file, merged with the ones it already has.
+ *
+ * EXIF tags of the file that the new segment does not set are kept (see parseExifSegment
+ * for what cannot be carried over). The new XMP rdf:Description is added to the existing
+ * packet, unless that packet already holds GPano tags, in which case it is replaced.
+ * A kind of segment absent from updates (e.g. EXIF when only XMP is given) is kept as is.
+ *
+ * Only the marker segments before the first SOS are parsed; the entropy-coded data is
+ * copied with one sequential pass into a temporary file that then replaces the original.
+ * New segments are placed right after SOI (and after a JFIF APP0 if there is one).
+ *
+ * @return true if the file was rewritten, false on any error (original left untouched)
+ */
+bool spliceJpegMetadata(const std::string& path, const std::vector<JpegSegment>& updates);
+
+#endif // JPEG_METADATA_H
@@ -2,120 +2,369 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <glob.h>
+#include <unistd.h>
+#include <json/json.h>
 
 // Inclure les headers du SDK
 #include "ins_stitcher.h"   // Contains VideoStitcher and ImageStitcher classes
 #include "ins_common.h"     // Contains common types and enums
 #include "exif_metadata.h"  // For adding 360° EXIF metadata
 #include "resolution_detector.h"  // For dynamic resolution detection
+#include "media_metadata.h"  // For the source metadata snapshot
+#include "spherical_metadata.h"  // For 360° video metadata (sv3d/st3d)
 
 namespace fs = std::filesystem;
 
+// Outcome of one input, reported in the JSON summary
+struct ConversionResult {
+    std::string input;
+    std::string output;
+    std::string status = "failed"; // "ok", "failed", "missing", "unsupported" or "conflict"
+    double seconds = 0.0;
+    uintmax_t outputBytes = 0;
+};
+
+static bool convertVideo(const std::string& input, const std::string& output_path) {
+    std::cout << "Converting video: " << input << std::endl;
+
+    auto videoStitcher = std::make_shared<ins::VideoStitcher>();
+
+    std::vector<std::string> inputs = { input };
+    videoStitcher->SetInputPath(inputs);
+    videoStitcher->SetOutputPath(output_path);
+
+    // Parameters (optional)
+    videoStitcher->EnableFlowState(true);      // stabilization
+    videoStitcher->EnableDirectionLock(true);  // direction lock
+    videoStitcher->EnableH265Encoder();        // H.265 if available
+    // 4K (2:1 ratio) at 60 Mbps at most, lowered to the native size of the clip
+    VideoOutputInfo video = detectVideoOutput(readMediaMetadata(input), 3840, 1920, 60 * 1000 * 1000);
+    videoStitcher->SetOutputBitRate(video.bitrate);
+    videoStitcher->SetOutputSize(video.width, video.height);
+
+    std::string name = fs::path(input).filename().string();
+    videoStitcher->SetStitchProgressCallback([name](int progress, int error) {
+        std::cout << "\r" << name << " progress: " << progress << "%" << std::flush;
+        if (error != 0) {
+            std::cerr << "\nError during stitch of " << name << ": code " << error << std::endl;
+        }
+    });
+
+    videoStitcher->StartStitch();
+    if (!fs::exists(output_path)) {
+        std::cerr << "\nError during video stitching: " << input << std::endl;
+        return false;
+    }
+    std::cout << "\nExport finished: " << output_path << std::endl;
+
+    // Tag the video as 360° equirectangular (only moov is rewritten)
+    if (!injectSphericalMetadata(output_path)) {
+        std::cerr << "Warning: Failed to add 360° video metadata to " << output_path << std::endl;
+    }
+    return true;
+}
+
+static bool convertPhoto(const std::string& input, const std::string& output_path) {
+    std::cout << "Converting photo: " << input << std::endl;
+
+    auto imageStitcher = std::make_shared<ins::ImageStitcher>();
+
+    std::vector<std::string> inputs = { input };
+    imageStitcher->SetInputPath(inputs);
+    imageStitcher->SetOutputPath(output_path);
+
+    // 🔍 DYNAMIC RESOLUTION DETECTION
+    // Read the source metadata once: used for resolution detection and EXIF injection
+    MediaMetadata metadata = readMediaMetadata(input);
+    ResolutionInfo resolution = detectOptimalResolution(metadata);
+
+    // Configure for CPU-only processing in containerized environment
+    imageStitcher->EnableCuda(false);
+    imageStitcher->SetImageProcessingAccelType(ins::ImageProcessingAccel::kCPU);
+
+    // 📐 Set optimal resolution dynamically based on detected camera model
+    imageStitcher->SetOutputSize(resolution.width, resolution.height);
+
+    // ✨ KEY OPTIMIZATION FOR PERFECT JUNCTIONS ✨
+    // Use OPTFLOW instead of TEMPLATE for superior seam blending
+    // This is the same algorithm used by the official Insta360 Studio
+    imageStitcher->SetStitchType(ins::STITCH_TYPE::OPTFLOW);
+
+    // ✨ CRITICAL: Enable advanced stitching fusion ✨
+    // This enables sophisticated blending at image boundaries
+    // Disabled previously to avoid crashes, but essential for quality
+    imageStitcher->EnableStitchFusion(true);
+
+    std::cout << "Starting image stitching..." << std::endl;
+    bool success = imageStitcher->Stitch();
+    std::cout << "Stitching completed with result: " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    if (!success || !fs::exists(output_path)) {
+        std::cerr << "Error during image stitching: " << input << std::endl;
+        return false;
+    }
+    std::cout << "Export finished: " << output_path << std::endl;
+
+    // Add 360° EXIF metadata to make the image recognizable as a panorama
+    // Use the dynamically detected resolution for metadata accuracy
+    const int pano_width = resolution.width;   // Dynamic resolution width
+    const int pano_height = resolution.height; // Dynamic resolution height
+
+    std::cout << "Adding 360° EXIF metadata..." << std::endl;
+    if (add360ExifMetadata(output_path, metadata, pano_width, pano_height)) {
+        std::cout << "Successfully added 360° EXIF metadata to " << output_path << std::endl;
+    } else {
+        std::cerr << "Warning: Failed to add 360° EXIF metadata to " << output_path << std::endl;
+    }
+    return true;
+}
+
+// Output of one input: <output_dir>/<stem>.mp4 for videos, .jpg for photos, "" if unsupported
+static std::string outputPathFor(const std::string& input, const std::string& output_dir) {
+    std::string ext = fs::path(input).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    const std::string stem = fs::path(input).stem().string();
+    if (ext == ".insv") return (fs::path(output_dir) / (stem + ".mp4")).string();
+    if (ext == ".insp" || ext == ".jpg") return (fs::path(output_dir) / (stem + ".jpg")).string();
+    return "";
+}
+
+// Absolute path with symlinks resolved as far as they exist, to compare outputs and inputs
+static fs::path normalizedPath(const std::string& path) {
+    std::error_code ec;
+    fs::path normalized = fs::weakly_canonical(path, ec);
+    if (ec) normalized = fs::absolute(path, ec).lexically_normal();
+    return normalized;
+}
+
+static ConversionResult convertFile(const std::string& input, const std::string& output) {
+    ConversionResult result;
+    result.input = input;
+    result.output = output;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::string ext = fs::path(input).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    try {
+        if (!fs::exists(input)) {
+            std::cerr << "Input file not found: " << input << "\n";
+            result.status = "missing";
+        } else if (output.empty()) {
+            std::cerr << "Unsupported file type: " << ext << "\n";
+            result.status = "unsupported";
+        } else if (ext == ".insv") {
+            if (convertVideo(input, output)) result.status = "ok";
+        } else if (convertPhoto(input, output)) {
+            result.status = "ok";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error converting " << input << ": " << e.what() << std::endl;
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::error_code ec;
+    if (result.status == "ok") {
+        result.outputBytes = fs::file_size(result.output, ec);
+    }
+    return result;
+}
+
+// Adds the files named by one argument: "-" reads paths from stdin, patterns go through glob(3)
+static void addInputs(const std::string& arg, std::vector<std::string>& inputs) {
+    if (arg == "-") {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) inputs.push_back(line);
+        }
+        return;
+    }
+    if (arg.find_first_of("*?[") == std::string::npos) {
+        inputs.push_back(arg);
+        return;
+    }
+
+    // Quoted patterns (e.g. "/data/*.insp"); no match keeps the pattern so it is reported as missing
+    glob_t matches{};
+    if (glob(arg.c_str(), GLOB_NOCHECK, nullptr, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; ++i) {
+            inputs.push_back(matches.gl_pathv[i]);
+        }
+    }
+    globfree(&matches);
+}
+
+static bool isSupportedInput(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".insv" || ext == ".insp" || ext == ".jpg";
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [-j N] [--summary FILE] <input.insv|insp>... <output_dir>\n"
+              << "       " << program << " [-j N] [--summary FILE] -o <output_dir> <input|pattern|->...\n"
+              << "  -j N            Convert N files at a time (default 1)\n"
+              << "  -o DIR          Output directory (default: last argument)\n"
+              << "  --summary FILE  Write the JSON summary to FILE instead of stdout\n"
+              << "  -               Read input paths from stdin, one per line\n";
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <input.insv|insp> <output_dir>\n";
+    int jobs = 1;
+    std::string output_dir;
+    std::string summary_path;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            jobs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (arg == "--summary" && i + 1 < argc) {
+            summary_path = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (output_dir.empty() && args.size() >= 2) {
+        // Without -o the last argument is the output directory: never take an input for it
+        const std::string& last = args.back();
+        if (last == "-" || isSupportedInput(last) || fs::is_regular_file(last)) {
+            std::cerr << "Error: " << last << " looks like an input, not an output directory (use -o DIR)\n";
+            return 1;
+        }
+        output_dir = last;
+        args.pop_back();
+    }
+    if (output_dir.empty() || args.empty()) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    std::string input = argv[1];
-    std::string output_dir = argv[2];
-
-    if (!fs::exists(input)) {
-        std::cerr << "Input file not found: " << input << "\n";
+    std::vector<std::string> inputs;
+    for (const auto& arg : args) {
+        addInputs(arg, inputs);
+    }
+    if (inputs.empty()) {
+        std::cerr << "No input files\n";
         return 1;
     }
     if (!fs::exists(output_dir)) {
         fs::create_directories(output_dir);
     }
 
+    // The JSON summary owns stdout unless it goes to a file. Descriptor 1 is pointed at stderr
+    // for the run, so logs from the SDK and libjpeg (printf, fwrite) cannot corrupt it either
+    int summaryFd = -1;
+    if (summary_path.empty()) {
+        std::fflush(stdout);
+        summaryFd = ::dup(STDOUT_FILENO);
+        if (summaryFd < 0 || ::dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            std::cerr << "Error: Cannot redirect stdout\n";
+            return 1;
+        }
+    }
+
+    // One SDK environment for every conversion
     ins::InitEnv();
 
-    std::string ext = fs::path(input).extension().string();
-    if (ext == ".insv") {
-        std::cout << "Converting video: " << input << std::endl;
+    // Every output is claimed before the first conversion starts: two inputs with the same stem
+    // (X.insp next to X.jpg, a pattern across DCIM folders) would race to write one file, and a
+    // .jpg converted into its own folder would overwrite its source
+    std::vector<ConversionResult> results(inputs.size());
+    std::map<fs::path, size_t> claimedOutputs;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        results[i].input = inputs[i];
+        results[i].output = outputPathFor(inputs[i], output_dir);
+        if (results[i].output.empty()) continue;
 
-        auto videoStitcher = std::make_shared<ins::VideoStitcher>();
+        const fs::path output = normalizedPath(results[i].output);
+        if (output == normalizedPath(inputs[i])) {
+            std::cerr << "Error: Converting " << inputs[i] << " would overwrite it (choose another -o DIR)\n";
+            results[i].status = "conflict";
+            continue;
+        }
+        const auto claim = claimedOutputs.emplace(output, i);
+        if (!claim.second) {
+            std::cerr << "Error: " << inputs[i] << " and " << inputs[claim.first->second] << " both convert to "
+                      << results[i].output << ", skipping " << inputs[i] << "\n";
+            results[i].status = "conflict";
+        }
+    }
 
-        std::vector<std::string> inputs = { input };
-        videoStitcher->SetInputPath(inputs);
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            if (results[i].status == "conflict") continue;
+            results[i] = convertFile(inputs[i], results[i].output);
+        }
+    };
 
-        std::string output_path = (fs::path(output_dir) / (fs::path(input).stem().string() + ".mp4")).string();
-        videoStitcher->SetOutputPath(output_path);
+    const size_t threadCount = std::min(inputs.size(), static_cast<size_t>(jobs));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
 
-        // Parameters (optional)
-        videoStitcher->EnableFlowState(true);      // stabilization
-        videoStitcher->EnableDirectionLock(true);  // direction lock
-        videoStitcher->EnableH265Encoder();        // H.265 if available
-        videoStitcher->SetOutputBitRate(60LL * 1000 * 1000); // 60 Mbps
-        videoStitcher->SetOutputSize(3840, 1920);  // 4K (2:1 ratio)
+    Json::Value summary;
+    int failed = 0;
+    for (const auto& result : results) {
+        Json::Value entry;
+        entry["input"] = result.input;
+        entry["output"] = result.output;
+        entry["status"] = result.status;
+        entry["seconds"] = result.seconds;
+        entry["outputBytes"] = static_cast<Json::UInt64>(result.outputBytes);
+        summary["files"].append(entry);
+        if (result.status != "ok") ++failed;
+    }
+    summary["succeeded"] = static_cast<int>(results.size()) - failed;
+    summary["failed"] = failed;
+    summary["jobs"] = static_cast<int>(threadCount);
+    summary["wallSeconds"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        videoStitcher->SetStitchProgressCallback([&](int progress, int error) {
-            std::cout << "\rProgress: " << progress << "%" << std::flush;
-            if (error != 0) {
-                std::cerr << "\nError during stitch: code " << error << std::endl;
-            }
-        });
-
-        videoStitcher->StartStitch();
-        std::cout << "\nExport finished: " << output_path << std::endl;
-
-    } else if (ext == ".insp" || ext == ".jpg") {
-        std::cout << "Converting photo: " << input << std::endl;
-
-        auto imageStitcher = std::make_shared<ins::ImageStitcher>();
-
-        std::vector<std::string> inputs = { input };
-        imageStitcher->SetInputPath(inputs);
-
-        std::string output_path = (fs::path(output_dir) / (fs::path(input).stem().string() + ".jpg")).string();
-        imageStitcher->SetOutputPath(output_path);
-
-        // 🔍 DYNAMIC RESOLUTION DETECTION 
-        // Automatically detect optimal resolution based on camera model
-        ResolutionInfo resolution = detectOptimalResolution(input);
-        
-        // Configure for CPU-only processing in containerized environment
-        imageStitcher->EnableCuda(false);
-        imageStitcher->SetImageProcessingAccelType(ins::ImageProcessingAccel::kCPU);
-        
-        // 📐 Set optimal resolution dynamically based on detected camera model
-        imageStitcher->SetOutputSize(resolution.width, resolution.height);
-        
-        // ✨ KEY OPTIMIZATION FOR PERFECT JUNCTIONS ✨
-        // Use OPTFLOW instead of TEMPLATE for superior seam blending
-        // This is the same algorithm used by the official Insta360 Studio
-        imageStitcher->SetStitchType(ins::STITCH_TYPE::OPTFLOW);
-        
-        // ✨ CRITICAL: Enable advanced stitching fusion ✨
-        // This enables sophisticated blending at image boundaries
-        // Disabled previously to avoid crashes, but essential for quality
-        imageStitcher->EnableStitchFusion(true);
-
-        std::cout << "Starting image stitching..." << std::endl;
-        bool success = imageStitcher->Stitch();
-        std::cout << "Stitching completed with result: " << (success ? "SUCCESS" : "FAILED") << std::endl;
-        if (success) {
-            std::cout << "Export finished: " << output_path << std::endl;
-            
-            // Add 360° EXIF metadata to make the image recognizable as a panorama
-            // Use the dynamically detected resolution for metadata accuracy
-            const int pano_width = resolution.width;   // Dynamic resolution width
-            const int pano_height = resolution.height; // Dynamic resolution height
-            
-            std::cout << "Adding 360° EXIF metadata..." << std::endl;
-            if (add360ExifMetadata(output_path, input, pano_width, pano_height)) {
-                std::cout << "Successfully added 360° EXIF metadata to " << output_path << std::endl;
-            } else {
-                std::cerr << "Warning: Failed to add 360° EXIF metadata to " << output_path << std::endl;
+    std::cout.flush();
+    std::fflush(stdout);
+    if (summaryFd >= 0) {
+        std::ostringstream json;
+        json << summary << "\n";
+        const std::string text = json.str();
+        size_t written = 0;
+        while (written < text.size()) {
+            const ssize_t n = ::write(summaryFd, text.data() + written, text.size() - written);
+            if (n <= 0) {
+                std::cerr << "Error: Cannot write summary to stdout\n";
+                return 1;
             }
-        } else {
-            std::cerr << "Error during image stitching" << std::endl;
-            return 1;
+            written += static_cast<size_t>(n);
         }
+        ::close(summaryFd);
     } else {
-        std::cerr << "Unsupported file type: " << ext << "\n";
-        return 1;
+        std::ofstream file(summary_path);
+        file << summary << std::endl;
+        if (!file.good()) {
+            std::cerr << "Error: Cannot write summary to " << summary_path << "\n";
+            return 1;
+        }
     }
 
-    return 0;
+    return failed > 0 ? 1 : 0;
 }
@@ -0,0 +1,395 @@
+#include "media_metadata.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include "file_reader.h"
+#include "mp4_box.h"
+
+namespace {
+
+struct PreservedTag {
+    ExifIfd ifd;
+    uint16_t tag;
+};
+
+// Tags copied to converted files (exact tags from .insp files)
+constexpr PreservedTag kPreservedTags[] = {
+    {ExifIfd::Image, 0x010F},  // Make
+    {ExifIfd::Image, 0x0110},  // Model (this becomes "Camera Model Name")
+    {ExifIfd::Image, 0x0132},  // DateTime
+    {ExifIfd::Image, 0x0131},  // Software
+    {ExifIfd::Photo, 0x9003},  // DateTimeOriginal
+    {ExifIfd::Photo, 0x9004},  // DateTimeDigitized
+    {ExifIfd::Photo, 0x829A},  // ExposureTime
+    {ExifIfd::Photo, 0x829D},  // FNumber
+    {ExifIfd::Photo, 0x8827},  // ISOSpeedRatings
+    {ExifIfd::Photo, 0xA403},  // WhiteBalance
+    {ExifIfd::Photo, 0x9209},  // Flash
+    {ExifIfd::Photo, 0x8822},  // ExposureProgram
+    {ExifIfd::Photo, 0x9207},  // MeteringMode
+    {ExifIfd::Photo, 0x920A},  // FocalLength
+    {ExifIfd::GPS, 0x0000},    // GPSVersionID
+    {ExifIfd::GPS, 0x0001},    // GPSLatitudeRef
+    {ExifIfd::GPS, 0x0002},    // GPSLatitude
+    {ExifIfd::GPS, 0x0003},    // GPSLongitudeRef
+    {ExifIfd::GPS, 0x0004},    // GPSLongitude
+    {ExifIfd::GPS, 0x0005},    // GPSAltitudeRef
+    {ExifIfd::GPS, 0x0006},    // GPSAltitude
+};
+
+bool isPreserved(ExifIfd ifd, uint16_t tag) {
+    return std::any_of(std::begin(kPreservedTags), std::end(kPreservedTags),
+                       [&](const PreservedTag& p) { return p.ifd == ifd && p.tag == tag; });
+}
+
+std::string asciiValue(const std::vector<uint8_t>& data) {
+    std::string value(data.begin(), data.end());
+    value.erase(std::find(value.begin(), value.end(), '\0'), value.end());
+    while (!value.empty() && value.back() == ' ') value.pop_back();
+    return value;
+}
+
+uint32_t leU32(const std::vector<uint8_t>& data, size_t offset) {
+    if (data.size() < offset + 4) return 0;
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (static_cast<uint32_t>(data[offset + 3]) << 24);
+}
+
+uint32_t leUnsigned(const ExifEntry& entry) {
+    if (entry.type == 3 && entry.data.size() >= 2) return entry.data[0] | (entry.data[1] << 8);
+    if (entry.type == 4) return leU32(entry.data, 0);
+    return 0;
+}
+
+double rationalValue(const ExifEntry& entry, size_t index) {
+    const uint32_t num = leU32(entry.data, 8 * index);
+    const uint32_t den = leU32(entry.data, 8 * index + 4);
+    return den ? static_cast<double>(num) / den : 0.0;
+}
+
+double gpsDegrees(const ExifEntry& entry) {
+    if (entry.type != 5 || entry.count < 3) return 0.0;
+    return rationalValue(entry, 0) + rationalValue(entry, 1) / 60.0 + rationalValue(entry, 2) / 3600.0;
+}
+
+// Fills the decoded fields of the snapshot from the preserved entries
+void decodeFields(MediaMetadata& meta, int pixelWidth, int pixelHeight) {
+    std::string dateTime, dateTimeOriginal;
+    char latRef = 'N', lonRef = 'E';
+    bool belowSeaLevel = false;
+    bool hasLat = false, hasLon = false;
+
+    for (const auto& entry : meta.preservedEntries) {
+        switch (entry.ifd) {
+            case ExifIfd::Image:
+                if (entry.tag == 0x010F) meta.make = asciiValue(entry.data);
+                if (entry.tag == 0x0110) meta.model = asciiValue(entry.data);
+                if (entry.tag == 0x0132) dateTime = asciiValue(entry.data);
+                break;
+            case ExifIfd::Photo:
+                if (entry.tag == 0x9003) dateTimeOriginal = asciiValue(entry.data);
+                if (entry.tag == 0x829A && entry.type == 5) meta.exposureTime = rationalValue(entry, 0);
+                if (entry.tag == 0x829D && entry.type == 5) meta.fNumber = rationalValue(entry, 0);
+                if (entry.tag == 0x8827) meta.iso = static_cast<int>(leUnsigned(entry));
+                break;
+            case ExifIfd::GPS:
+                if (entry.tag == 0x0001 && !entry.data.empty()) latRef = static_cast<char>(entry.data[0]);
+                if (entry.tag == 0x0002) { meta.latitude = gpsDegrees(entry); hasLat = true; }
+                if (entry.tag == 0x0003 && !entry.data.empty()) lonRef = static_cast<char>(entry.data[0]);
+                if (entry.tag == 0x0004) { meta.longitude = gpsDegrees(entry); hasLon = true; }
+                if (entry.tag == 0x0005 && !entry.data.empty()) belowSeaLevel = entry.data[0] == 1;
+                if (entry.tag == 0x0006 && entry.type == 5) meta.altitude = rationalValue(entry, 0);
+                break;
+        }
+    }
+
+    meta.captureTime = !dateTimeOriginal.empty() ? dateTimeOriginal : dateTime;
+    meta.hasGps = hasLat && hasLon;
+    if (latRef == 'S') meta.latitude = -meta.latitude;
+    if (lonRef == 'W') meta.longitude = -meta.longitude;
+    if (belowSeaLevel) meta.altitude = -meta.altitude;
+    if (pixelWidth > 0 && pixelHeight > 0) {
+        meta.width = pixelWidth;
+        meta.height = pixelHeight;
+    }
+}
+
+// Walks the JPEG marker segments up to SOS: EXIF from APP1, frame size from SOFn. Only
+// the marker headers and the segments that are decoded are read.
+void parseJpegHeader(const FileReader& file, MediaMetadata& meta) {
+    const uint64_t size = file.size();
+    uint8_t header[4];
+    if (size < 4 || !file.read(0, header, 2) || header[0] != 0xFF || header[1] != 0xD8) return;
+
+    int pixelWidth = 0, pixelHeight = 0;
+    uint64_t pos = 2;
+    std::vector<uint8_t> payload;
+    while (pos + 4 <= size && file.read(pos, header, 4) && header[0] == 0xFF) {
+        const uint8_t marker = header[1];
+        if (marker == 0xFF) { ++pos; continue; }  // Fill byte
+        if (marker == 0xDA || marker == 0xD9) break;
+
+        const size_t length = (static_cast<size_t>(header[2]) << 8) | header[3];
+        if (length < 2 || pos + 2 + length > size) break;
+        const size_t payloadSize = length - 2;
+        const bool isSof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+
+        std::vector<ExifEntry> entries;
+        if (marker == 0xE1 && !meta.valid) {
+            if (!file.read(pos + 4, payloadSize, payload)) break;
+            if (parseExifSegment(payload.data(), payloadSize, entries)) {
+                for (auto& entry : entries) {
+                    if (entry.ifd == ExifIfd::Photo && (entry.tag == 0xA002 || entry.tag == 0xA003)) {
+                        (entry.tag == 0xA002 ? pixelWidth : pixelHeight) = static_cast<int>(leUnsigned(entry));
+                    } else if (isPreserved(entry.ifd, entry.tag)) {
+                        meta.preservedEntries.push_back(std::move(entry));
+                    }
+                }
+                meta.valid = true;
+            }
+        } else if (isSof && payloadSize >= 5 && meta.width == 0) {
+            uint8_t frame[5];
+            if (!file.read(pos + 4, frame, sizeof(frame))) break;
+            meta.height = (frame[1] << 8) | frame[2];
+            meta.width = (frame[3] << 8) | frame[4];
+        }
+        pos += 2 + length;
+    }
+
+    decodeFields(meta, pixelWidth, pixelHeight);
+}
+
+// Seconds between 1904-01-01 (MP4 epoch) and 1970-01-01
+constexpr uint64_t kMp4EpochOffset = 2082844800ull;
+
+std::string formatMp4Time(uint64_t mp4Seconds) {
+    if (mp4Seconds <= kMp4EpochOffset) return "";
+    const time_t unixTime = static_cast<time_t>(mp4Seconds - kMp4EpochOffset);
+    struct tm utc{};
+    if (!gmtime_r(&unixTime, &utc)) return "";
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y:%m:%d %H:%M:%S", &utc);
+    return buffer;
+}
+
+// Decode time of every sync sample, from the stts runs and stss (no stss: every sample)
+void readSyncSampleTimes(const Mp4Box& stbl, uint32_t timescale, std::vector<int64_t>& syncMs) {
+    const Mp4Box* stts = stbl.child("stts");
+    if (!stts || stts->payload.size() < 8) return;
+    const uint8_t* runs = stts->payload.data() + 8;
+    const uint32_t runCount = readBE32(stts->payload.data() + 4);
+    if (stts->payload.size() < 8 + 8ull * runCount) return;
+
+    const Mp4Box* stss = stbl.child("stss");
+    uint32_t syncCount = 0;
+    if (stss) {
+        if (stss->payload.size() < 8) return;
+        syncCount = readBE32(stss->payload.data() + 4);
+        if (stss->payload.size() < 8 + 4ull * syncCount) return;
+    }
+
+    // Both tables are in sample order: walk them together
+    uint64_t time = 0;
+    uint64_t firstSample = 1;  // 1-based number of the first sample of the current run
+    uint32_t run = 0;
+    auto addSample = [&](uint64_t sample) {
+        for (; run < runCount; ++run) {
+            const uint32_t count = readBE32(runs + 8 * run);
+            const uint32_t delta = readBE32(runs + 8 * run + 4);
+            if (sample < firstSample + count) {
+                syncMs.push_back(static_cast<int64_t>((time + (sample - firstSample) * delta) * 1000 / timescale));
+                return true;
+            }
+            time += static_cast<uint64_t>(count) * delta;
+            firstSample += count;
+        }
+        return false;
+    };
+    if (!stss) {
+        for (uint64_t sample = 1; addSample(sample); ++sample) {}
+        return;
+    }
+    for (uint32_t i = 0; i < syncCount; ++i) {
+        const uint32_t sample = readBE32(stss->payload.data() + 8 + 4 * i);
+        if (sample < firstSample || !addSample(sample)) break;
+    }
+}
+
+// Reads creation time, video track size, duration, frame rate and GOP starts from moov
+void parseMovieHeader(const Mp4Box& moov, MediaMetadata& meta) {
+    if (const Mp4Box* mvhd = moov.child("mvhd")) {
+        const auto& p = mvhd->payload;
+        if (p.size() >= 12) {
+            meta.captureTime = formatMp4Time(p[0] == 1 ? readBE64(p.data() + 4) : readBE32(p.data() + 4));
+        }
+    }
+
+    const Mp4Box* trak = findTrack(moov, "vide");
+    if (!trak) return;
+
+    if (const Mp4Box* tkhd = trak->child("tkhd")) {
+        // Width and height are 16.16 fixed point after the matrix
+        const auto& p = tkhd->payload;
+        const size_t sizeOffset = p.empty() || p[0] == 0 ? 76 : 88;
+        if (p.size() >= sizeOffset + 8) {
+            meta.width = static_cast<int>(readBE32(p.data() + sizeOffset) >> 16);
+            meta.height = static_cast<int>(readBE32(p.data() + sizeOffset + 4) >> 16);
+        }
+    }
+
+    uint32_t timescale = 0;
+    uint64_t duration = 0;
+    if (const Mp4Box* mdhd = trak->find("mdia/mdhd")) {
+        const auto& p = mdhd->payload;
+        if (!p.empty() && p[0] == 1 && p.size() >= 32) {
+            timescale = readBE32(p.data() + 20);
+            duration = readBE64(p.data() + 24);
+        } else if (p.size() >= 20) {
+            timescale = readBE32(p.data() + 12);
+            duration = readBE32(p.data() + 16);
+        }
+    }
+    if (timescale > 0 && duration > 0) {
+        meta.durationSeconds = static_cast<double>(duration) / timescale;
+        if (const Mp4Box* stsz = trak->find("mdia/minf/stbl/stsz")) {
+            if (stsz->payload.size() >= 12) {
+                meta.frameRate = readBE32(stsz->payload.data() + 8) / meta.durationSeconds;
+            }
+        }
+        if (const Mp4Box* stbl = trak->find("mdia/minf/stbl")) {
+            readSyncSampleTimes(*stbl, timescale, meta.syncSampleMs);
+        }
+    }
+}
+
+uint64_t readVarint(const uint8_t*& p, const uint8_t* end) {
+    uint64_t value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+// Camera info record: protobuf fields 1 = serial number, 2 = camera type, 3 = firmware
+void parseCameraInfoRecord(const uint8_t* p, const uint8_t* end, MediaMetadata& meta) {
+    while (p < end) {
+        const uint64_t key = readVarint(p, end);
+        const uint64_t field = key >> 3;
+        switch (key & 7) {
+            case 0: readVarint(p, end); break;
+            case 1: p += 8; break;
+            case 5: p += 4; break;
+            case 2: {
+                const uint64_t length = readVarint(p, end);
+                if (length > static_cast<uint64_t>(end - p)) return;
+                const std::string value(reinterpret_cast<const char*>(p), length);
+                if (field == 1) meta.serialNumber = value;
+                if (field == 2) meta.model = value;
+                if (field == 3) meta.firmware = value;
+                p += length;
+                break;
+            }
+            default: return;  // Groups are not used in this record
+        }
+    }
+}
+
+/**
+ * Insta360 trailer appended after the MP4 boxes of .insv files. The file ends with a
+ * 78-byte block: a record header (u16 id, u32 length, little-endian), the trailer length
+ * at offset 38, and a 32-character magic. Records are laid out back to back, each one's
+ * data followed by its header, so they are walked from the end.
+ */
+void parseInsta360Trailer(const FileReader& file, MediaMetadata& meta) {
+    static const char kMagic[] = "8db42d694ccc418790edff439fe026bf";
+    constexpr uint64_t kBlockSize = 78;
+    const uint64_t size = file.size();
+    uint8_t block[kBlockSize];
+    if (size < kBlockSize || !file.read(size - kBlockSize, block, kBlockSize)) return;
+    if (std::memcmp(block + kBlockSize - 32, kMagic, 32) != 0) return;
+
+    auto le32 = [](const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    };
+    const uint64_t trailerLength = le32(block + 38);
+    if (trailerLength < kBlockSize || trailerLength > size) return;
+    const uint64_t trailerStart = size - trailerLength;
+
+    // Only the record headers and the camera info record are read
+    uint64_t headerPos = size - kBlockSize;
+    uint8_t header[6];
+    std::copy(block, block + sizeof(header), header);
+    while (true) {
+        const uint16_t id = static_cast<uint16_t>(header[0] | (header[1] << 8));
+        const uint64_t length = le32(header + 2);
+        if (length > headerPos - trailerStart) break;
+        const uint64_t recordStart = headerPos - length;
+
+        if (id == 0x101) {
+            std::vector<uint8_t> record;
+            if (file.read(recordStart, static_cast<size_t>(length), record)) {
+                parseCameraInfoRecord(record.data(), record.data() + record.size(), meta);
+            }
+            break;
+        }
+        if (recordStart < trailerStart + 6) break;
+        headerPos = recordStart - 6;
+        if (!file.read(headerPos, header, sizeof(header))) break;
+    }
+
+    if (!meta.model.empty()) {
+        if (meta.make.empty()) meta.make = "Insta360";
+        meta.valid = true;
+    }
+}
+
+// Larger moov boxes are treated as corrupt (an hour of 8K video has a few tens of MB)
+constexpr uint64_t kMaxMoovSize = 256ull << 20;
+
+// MP4/INSV: only the box headers, moov and the trailer are read, never mdat
+void parseMp4File(const FileReader& file, MediaMetadata& meta) {
+    for (const auto& box : scanMp4Boxes(file, 0, file.size())) {
+        if (box.type != "moov" || box.size > kMaxMoovSize) continue;
+        std::vector<uint8_t> bytes;
+        Mp4Box moov;
+        if (file.read(box.offset, static_cast<size_t>(box.size), bytes) && parseMp4Box(bytes.data(), box.size, moov)) {
+            parseMovieHeader(moov, meta);
+            meta.valid = meta.width > 0 && meta.height > 0;
+        }
+        break;
+    }
+    parseInsta360Trailer(file, meta);
+}
+
+} // namespace
+
+MediaMetadata readMediaMetadata(const std::string& path) {
+    MediaMetadata meta;
+    meta.path = path;
+
+    FileReader file(path);
+    if (!file.opened()) {
+        std::cerr << "Warning: Cannot open file for metadata: " << path << std::endl;
+        return meta;
+    }
+    meta.fileSize = file.size();
+
+    uint8_t magic[8];
+    if (file.size() >= 8 && file.read(0, magic, sizeof(magic)) && std::memcmp(magic + 4, "ftyp", 4) == 0) {
+        parseMp4File(file, meta);
+    } else {
+        parseJpegHeader(file, meta);
+    }
+
+    // A file cut short while it was read (copy in progress) fails on its own, like any unreadable file
+    if (file.failed()) {
+        std::cerr << "Warning: File changed while reading its metadata: " << path << std::endl;
+        MediaMetadata partial;
+        partial.path = path;
+        partial.fileSize = meta.fileSize;
+        return partial;
+    }
+    return meta;
+}
@@ -0,0 +1,53 @@
+#ifndef MEDIA_METADATA_H
+#define MEDIA_METADATA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "jpeg_metadata.h"
+
+// Everything the pipeline needs to know about an input file, parsed once per job
+struct MediaMetadata {
+    std::string path;
+    bool valid = false;        // EXIF header, or MP4 movie header / Insta360 trailer, parsed
+    uint64_t fileSize = 0;
+
+    std::string make;
+    std::string model;
+    int width = 0;             // PixelXDimension, the JPEG frame size, or the video track size
+    int height = 0;
+    std::string captureTime;   // DateTimeOriginal, DateTime or movie creation time ("YYYY:MM:DD HH:MM:SS")
+
+    double exposureTime = 0.0; // Seconds
+    double fNumber = 0.0;
+    int iso = 0;
+
+    bool hasGps = false;
+    double latitude = 0.0;     // Degrees, negative = south
+    double longitude = 0.0;    // Degrees, negative = west
+    double altitude = 0.0;     // Meters, negative = below sea level
+
+    // Videos (.insv/.mp4): video track timing and the Insta360 trailer identification
+    double durationSeconds = 0.0;
+    double frameRate = 0.0;
+    std::string serialNumber;
+    std::string firmware;
+    std::vector<int64_t> syncSampleMs; // Decode time of every sync sample (GOP start) of the video track
+
+    // Tags carried over to converted files (camera, exposure, capture time, GPS)
+    std::vector<ExifEntry> preservedEntries;
+};
+
+/**
+ * Reads the metadata snapshot of an input file.
+ *
+ * Only the JPEG marker segments before the image data are walked, and only the ones that
+ * are decoded are read, so just a few kilobytes come from disk, even for 70 MP files.
+ * MP4 based files (.insv, .mp4) get the same treatment: the top-level boxes are listed
+ * from their headers, only moov is read and parsed, and the Insta360 trailer at the end of
+ * .insv files is read for the camera model. Unrecognized files, and files truncated while
+ * they are read (copy in progress), still get their path and size.
+ */
+MediaMetadata readMediaMetadata(const std::string& path);
+
+#endif // MEDIA_METADATA_H
@@ -0,0 +1,67 @@
+#include "metadata_harvester.h"
+#include <algorithm>
+#include <iostream>
+
+MetadataHarvester::MetadataHarvester(int threads) {
+    const int count = std::max(1, threads);
+    for (int i = 0; i < count; ++i) {
+        workers_.emplace_back(&MetadataHarvester::run, this);
+    }
+}
+
+MetadataHarvester::~MetadataHarvester() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void MetadataHarvester::submit(const std::string& path, Callback onReady) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back(path, std::move(onReady));
+    }
+    cv_.notify_one();
+}
+
+size_t MetadataHarvester::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size() + active_;
+}
+
+void MetadataHarvester::run() {
+    while (true) {
+        std::pair<std::string, Callback> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            ++active_;
+        }
+
+        // A file that cannot be read still gets a (path-only) snapshot: the callback decides
+        std::shared_ptr<const MediaMetadata> snapshot;
+        try {
+            snapshot = std::make_shared<const MediaMetadata>(readMediaMetadata(task.first));
+        } catch (const std::exception& e) {
+            std::cerr << "Error harvesting metadata for " << task.first << ": " << e.what() << std::endl;
+            auto empty = std::make_shared<MediaMetadata>();
+            empty->path = task.first;
+            snapshot = std::move(empty);
+        }
+        try {
+            task.second(std::move(snapshot));
+        } catch (const std::exception& e) {
+            std::cerr << "Error queuing harvested file " << task.first << ": " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        --active_;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef METADATA_HARVESTER_H
+#define METADATA_HARVESTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "media_metadata.h"
+
+/**
+ * Small bounded thread pool that reads metadata snapshots in the background.
+ *
+ * The pool is deliberately small (a couple of threads): header reads are I/O bound and
+ * more concurrent readers only thrash NAS disks. Callbacks run on the pool threads and are
+ * called for every submitted file, with a path-only snapshot if it could not be read.
+ */
+class MetadataHarvester {
+public:
+    using Callback = std::function<void(std::shared_ptr<const MediaMetadata>)>;
+
+    explicit MetadataHarvester(int threads);
+    ~MetadataHarvester();
+
+    MetadataHarvester(const MetadataHarvester&) = delete;
+    MetadataHarvester& operator=(const MetadataHarvester&) = delete;
+
+    // Queues a file; onReady receives its snapshot once read
+    void submit(const std::string& path, Callback onReady);
+
+    // Files queued or being read
+    size_t pending() const;
+
+private:
+    void run();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::pair<std::string, Callback>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t active_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // METADATA_HARVESTER_H
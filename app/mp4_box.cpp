@@ -0,0 +1,224 @@
+#include "mp4_box.h"
+#include <cstring>
+#include "file_reader.h"
+
+namespace {
+
+// Bytes of own fields before the child boxes, or -1 for leaf boxes
+int childOffset(const std::string& type) {
+    static const char* const kContainers[] = {
+        "moov", "trak", "mdia", "minf", "stbl", "dinf", "edts", "mvex", "sv3d", "proj",
+    };
+    for (const char* container : kContainers) {
+        if (type == container) return 0;
+    }
+    if (type == "stsd") return 8;  // version/flags + entry count
+    if (type == "avc1" || type == "avc3" || type == "hvc1" || type == "hev1" || type == "mp4v") {
+        return 78;  // VisualSampleEntry fields
+    }
+    return -1;
+}
+
+bool parseChildren(const uint8_t* data, uint64_t size, std::vector<Mp4Box>& children) {
+    uint64_t pos = 0;
+    while (pos < size) {
+        if (size - pos < 8) return false;
+        uint64_t boxSize = readBE32(data + pos);
+        if (boxSize == 1) {
+            if (size - pos < 16) return false;
+            boxSize = readBE64(data + pos + 8);
+        } else if (boxSize == 0) {
+            boxSize = size - pos;
+        }
+        if (boxSize < 8 || boxSize > size - pos) return false;
+
+        Mp4Box child;
+        if (!parseMp4Box(data + pos, boxSize, child)) return false;
+        children.push_back(std::move(child));
+        pos += boxSize;
+    }
+    return true;
+}
+
+// Decodes the header at p of a box with room bytes left in its parent (at least 8 readable,
+// 16 if room allows); false if it is malformed or overflows the parent
+bool decodeBoxHeader(const uint8_t* p, uint64_t room, Mp4BoxRef& ref) {
+    ref.type.assign(reinterpret_cast<const char*>(p + 4), 4);
+    ref.size = readBE32(p);
+    ref.headerSize = 8;
+    if (ref.size == 1) {
+        if (room < 16) return false;
+        ref.size = readBE64(p + 8);
+        ref.headerSize = 16;
+    } else if (ref.size == 0) {
+        ref.size = room;
+    }
+    return ref.size >= ref.headerSize && ref.size <= room;
+}
+
+} // namespace
+
+uint16_t readBE16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint64_t readBE64(const uint8_t* p) {
+    return (static_cast<uint64_t>(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+void writeBE32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+void writeBE64(uint8_t* p, uint64_t value) {
+    writeBE32(p, static_cast<uint32_t>(value >> 32));
+    writeBE32(p + 4, static_cast<uint32_t>(value));
+}
+
+void appendBE16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void appendBE32(std::vector<uint8_t>& out, uint32_t value) {
+    uint8_t bytes[4];
+    writeBE32(bytes, value);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void appendBE64(std::vector<uint8_t>& out, uint64_t value) {
+    uint8_t bytes[8];
+    writeBE64(bytes, value);
+    out.insert(out.end(), bytes, bytes + 8);
+}
+
+std::vector<Mp4BoxRef> scanMp4Boxes(const uint8_t* data, uint64_t begin, uint64_t end) {
+    std::vector<Mp4BoxRef> boxes;
+    uint64_t pos = begin;
+    Mp4BoxRef ref;
+    while (pos < end && end - pos >= 8 && decodeBoxHeader(data + pos, end - pos, ref)) {
+        ref.offset = pos;
+        boxes.push_back(ref);
+        pos += ref.size;
+    }
+    return boxes;
+}
+
+std::vector<Mp4BoxRef> scanMp4Boxes(const FileReader& file, uint64_t begin, uint64_t end) {
+    std::vector<Mp4BoxRef> boxes;
+    uint64_t pos = begin;
+    Mp4BoxRef ref;
+    uint8_t header[16];
+    while (pos < end && end - pos >= 8) {
+        const size_t headerBytes = end - pos >= 16 ? 16 : 8;
+        if (!file.read(pos, header, headerBytes) || !decodeBoxHeader(header, end - pos, ref)) break;
+        ref.offset = pos;
+        boxes.push_back(ref);
+        pos += ref.size;
+    }
+    return boxes;
+}
+
+Mp4Box* Mp4Box::child(const std::string& childType) {
+    for (auto& box : children) {
+        if (box.type == childType) return &box;
+    }
+    return nullptr;
+}
+
+const Mp4Box* Mp4Box::child(const std::string& childType) const {
+    return const_cast<Mp4Box*>(this)->child(childType);
+}
+
+Mp4Box* Mp4Box::find(const std::string& path) {
+    Mp4Box* box = this;
+    size_t start = 0;
+    while (box && start <= path.size()) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string::npos) slash = path.size();
+        box = box->child(path.substr(start, slash - start));
+        start = slash + 1;
+    }
+    return box;
+}
+
+const Mp4Box* Mp4Box::find(const std::string& path) const {
+    return const_cast<Mp4Box*>(this)->find(path);
+}
+
+uint64_t Mp4Box::size() const {
+    uint64_t total = 8 + payload.size();
+    for (const auto& box : children) {
+        total += box.size();
+    }
+    return total > 0xFFFFFFFFull ? total + 8 : total;
+}
+
+bool parseMp4Box(const uint8_t* data, uint64_t size, Mp4Box& box) {
+    if (size < 8) return false;
+    uint64_t boxSize = readBE32(data);
+    uint64_t headerSize = 8;
+    if (boxSize == 1) {
+        if (size < 16) return false;
+        boxSize = readBE64(data + 8);
+        headerSize = 16;
+    } else if (boxSize == 0) {
+        boxSize = size;
+    }
+    if (boxSize < headerSize || boxSize > size) return false;
+
+    box.type.assign(reinterpret_cast<const char*>(data + 4), 4);
+    box.children.clear();
+    const uint8_t* body = data + headerSize;
+    const uint64_t bodySize = boxSize - headerSize;
+
+    const int offset = childOffset(box.type);
+    if (offset >= 0 && static_cast<uint64_t>(offset) <= bodySize) {
+        box.payload.assign(body, body + offset);
+        if (parseChildren(body + offset, bodySize - offset, box.children)) {
+            return true;
+        }
+        box.children.clear();  // Unexpected layout: keep it opaque
+    }
+    box.payload.assign(body, body + bodySize);
+    return true;
+}
+
+void appendMp4Box(std::vector<uint8_t>& out, const Mp4Box& box) {
+    const uint64_t total = box.size();
+    if (total > 0xFFFFFFFFull) {
+        appendBE32(out, 1);
+        out.insert(out.end(), box.type.begin(), box.type.end());
+        appendBE64(out, total);
+    } else {
+        appendBE32(out, static_cast<uint32_t>(total));
+        out.insert(out.end(), box.type.begin(), box.type.end());
+    }
+    out.insert(out.end(), box.payload.begin(), box.payload.end());
+    for (const auto& child : box.children) {
+        appendMp4Box(out, child);
+    }
+}
+
+Mp4Box* findTrack(Mp4Box& moov, const char* handlerType) {
+    for (auto& trak : moov.children) {
+        if (trak.type != "trak") continue;
+        const Mp4Box* hdlr = trak.find("mdia/hdlr");
+        // hdlr: version/flags (4), pre_defined (4), handler_type (4)
+        if (hdlr && hdlr->payload.size() >= 12 && std::memcmp(hdlr->payload.data() + 8, handlerType, 4) == 0) {
+            return &trak;
+        }
+    }
+    return nullptr;
+}
+
+const Mp4Box* findTrack(const Mp4Box& moov, const char* handlerType) {
+    return findTrack(const_cast<Mp4Box&>(moov), handlerType);
+}
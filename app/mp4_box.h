@@ -0,0 +1,73 @@
+#ifndef MP4_BOX_H
+#define MP4_BOX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Big-endian field access used by every MP4 structure
+uint16_t readBE16(const uint8_t* p);
+uint32_t readBE32(const uint8_t* p);
+uint64_t readBE64(const uint8_t* p);
+void writeBE32(uint8_t* p, uint32_t value);
+void writeBE64(uint8_t* p, uint64_t value);
+void appendBE16(std::vector<uint8_t>& out, uint16_t value);
+void appendBE32(std::vector<uint8_t>& out, uint32_t value);
+void appendBE64(std::vector<uint8_t>& out, uint64_t value);
+
+// Location of a box inside a file or buffer (no payload loaded)
+struct Mp4BoxRef {
+    std::string type;
+    uint64_t offset;      // Offset of the box header
+    uint64_t size;        // Whole box, header included
+    uint32_t headerSize;  // 8, or 16 with a 64-bit size
+};
+
+class FileReader;
+
+/**
+ * Lists the sibling boxes stored in [begin, end) of a buffer or a file (typically its top
+ * level). Only box headers are read, so mdat payloads are never touched. Stops at the first
+ * malformed header, or at a short read of the file.
+ */
+std::vector<Mp4BoxRef> scanMp4Boxes(const uint8_t* data, uint64_t begin, uint64_t end);
+std::vector<Mp4BoxRef> scanMp4Boxes(const FileReader& file, uint64_t begin, uint64_t end);
+
+/**
+ * In-memory box tree, used for moov (a few megabytes at most).
+ *
+ * Containers keep their children parsed; payload then holds the bytes that precede the
+ * children (e.g. the 8-byte header of stsd, or the 78-byte visual sample entry fields).
+ * Leaf boxes keep their whole body in payload. Sizes are recomputed on serialization, so
+ * inserting or growing a box automatically fixes every parent.
+ */
+struct Mp4Box {
+    std::string type;
+    std::vector<uint8_t> payload;
+    std::vector<Mp4Box> children;
+
+    Mp4Box* child(const std::string& childType);
+    const Mp4Box* child(const std::string& childType) const;
+
+    // Slash-separated path of child types, e.g. "mdia/minf/stbl"
+    Mp4Box* find(const std::string& path);
+    const Mp4Box* find(const std::string& path) const;
+
+    // Serialized size, header included
+    uint64_t size() const;
+};
+
+/**
+ * Parses the box starting at data (header included) into a tree.
+ * @return false if the header is malformed or does not fit in size
+ */
+bool parseMp4Box(const uint8_t* data, uint64_t size, Mp4Box& box);
+
+// Serializes a box tree (header included)
+void appendMp4Box(std::vector<uint8_t>& out, const Mp4Box& box);
+
+// Returns the first trak of moov whose handler is the given type ("vide", "soun", ...)
+Mp4Box* findTrack(Mp4Box& moov, const char* handlerType);
+const Mp4Box* findTrack(const Mp4Box& moov, const char* handlerType);
+
+#endif // MP4_BOX_H
@@ -0,0 +1,533 @@
+#include "mp4_concat.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include "file_reader.h"
+#include "mp4_box.h"
+
+namespace {
+
+using Runs = std::vector<std::pair<uint32_t, uint32_t>>;  // (sample count, value)
+
+struct ChunkEntry {
+    uint64_t offset;
+    uint32_t samples;
+    uint32_t descriptionIndex;  // 1-based, into the merged stsd
+};
+
+// Edit list entry; duration in the output movie timescale
+struct Edit {
+    uint64_t duration;
+    int64_t mediaTime;  // -1 = empty edit
+    uint32_t rate;      // 16.16 fixed point
+};
+
+// Merged sample tables of one track
+struct TrackTables {
+    std::string handler;
+    uint32_t timescale = 0;
+    uint64_t duration = 0;
+    Runs timeToSample;
+    bool hasCompositionOffsets = false;
+    uint8_t compositionVersion = 0;
+    Runs compositionOffsets;
+    std::vector<uint32_t> sampleSizes;
+    bool hasSyncSamples = false;
+    std::vector<uint32_t> syncSamples;
+    std::vector<ChunkEntry> chunks;
+    std::vector<Mp4Box> descriptions;
+    bool hasEdits = false;
+    std::vector<Edit> edits;
+};
+
+// Sample data of one segment: from the first mdat payload to the end of the last mdat
+struct SegmentData {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+void appendRun(Runs& runs, uint32_t count, uint32_t value) {
+    if (count == 0) return;
+    if (!runs.empty() && runs.back().second == value) {
+        runs.back().first += count;
+    } else {
+        runs.emplace_back(count, value);
+    }
+}
+
+// Entry count of a table box, checking that all entries are present
+bool tableEntries(const Mp4Box* box, size_t headerSize, size_t entrySize, uint32_t& count) {
+    if (!box || box->payload.size() < headerSize) return false;
+    count = readBE32(box->payload.data() + headerSize - 4);
+    return box->payload.size() >= headerSize + static_cast<uint64_t>(entrySize) * count;
+}
+
+bool sameBox(const Mp4Box& a, const Mp4Box& b) {
+    std::vector<uint8_t> bytesA, bytesB;
+    appendMp4Box(bytesA, a);
+    appendMp4Box(bytesB, b);
+    return bytesA == bytesB;
+}
+
+uint32_t movieTimescaleOf(const Mp4Box& moov) {
+    const Mp4Box* mvhd = moov.child("mvhd");
+    if (!mvhd || mvhd->payload.size() < 32) return 0;
+    return readBE32(mvhd->payload.data() + (mvhd->payload[0] == 1 ? 20 : 12));
+}
+
+std::string handlerType(const Mp4Box& trak) {
+    const Mp4Box* hdlr = trak.find("mdia/hdlr");
+    if (!hdlr || hdlr->payload.size() < 12) return "";
+    return std::string(reinterpret_cast<const char*>(hdlr->payload.data() + 8), 4);
+}
+
+// Appends the edit list of one segment track (or an edit of all its media if it has none),
+// with media times moved to where its samples start in the merged track. Every segment keeps
+// the part it presented on its own, so the AAC priming (encoder delay) at the start of each
+// segment's audio stays trimmed, not only the first one's.
+bool appendEdits(TrackTables& track, const Mp4Box& trak, uint64_t mediaStart, uint64_t mediaDuration,
+                 uint32_t segmentMovieTimescale, uint32_t movieTimescale) {
+    auto toMovie = [&](uint64_t duration, uint32_t timescale) {
+        return timescale ? duration * movieTimescale / timescale : 0;
+    };
+    auto add = [&](Edit edit) {
+        // An edit continuing the previous one (no samples skipped in between) extends it
+        if (!track.edits.empty()) {
+            Edit& last = track.edits.back();
+            if (last.mediaTime >= 0 && edit.mediaTime >= 0 && last.rate == 0x00010000 && edit.rate == 0x00010000 &&
+                (edit.mediaTime - last.mediaTime) * static_cast<int64_t>(movieTimescale) ==
+                    static_cast<int64_t>(last.duration * track.timescale)) {
+                last.duration += edit.duration;
+                return;
+            }
+        }
+        track.edits.push_back(edit);
+    };
+
+    const Mp4Box* elst = trak.find("edts/elst");
+    uint32_t count = 0;
+    if (elst) {
+        const size_t entrySize = !elst->payload.empty() && elst->payload[0] == 1 ? 20 : 12;
+        if (!tableEntries(elst, 8, entrySize, count)) return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t* e = elst->payload.data() + 8 + entrySize * i;
+            uint64_t duration = entrySize == 20 ? readBE64(e) : readBE32(e);
+            const int64_t mediaTime = entrySize == 20 ? static_cast<int64_t>(readBE64(e + 8))
+                                                      : static_cast<int32_t>(readBE32(e + 4));
+            if (mediaTime >= 0 && static_cast<uint64_t>(mediaTime) > mediaDuration) return false;
+            if (duration == 0 && count == 1 && mediaTime >= 0) {
+                // Zero duration: the rest of the media (written by fragmenting muxers)
+                duration = (mediaDuration - mediaTime) * segmentMovieTimescale / track.timescale;
+            }
+            add({toMovie(duration, segmentMovieTimescale), mediaTime < 0 ? -1 : mediaTime + static_cast<int64_t>(mediaStart),
+                 readBE32(e + entrySize - 4)});
+        }
+        track.hasEdits = true;
+    }
+    if (count == 0) {
+        add({toMovie(mediaDuration, track.timescale), static_cast<int64_t>(mediaStart), 0x00010000});
+    }
+    return true;
+}
+
+// Appends the samples of one segment track; newOffset = oldOffset + shift
+bool appendTrack(TrackTables& track, const Mp4Box& trak, const SegmentData& data, int64_t shift,
+                 uint32_t segmentMovieTimescale, uint32_t movieTimescale) {
+    const Mp4Box* mdhd = trak.find("mdia/mdhd");
+    const Mp4Box* stbl = trak.find("mdia/minf/stbl");
+    if (!mdhd || !stbl || mdhd->payload.size() < 24) return false;
+    const uint32_t timescale = readBE32(mdhd->payload.data() + (mdhd->payload[0] == 1 ? 20 : 12));
+    if (track.timescale == 0) track.timescale = timescale;
+    if (timescale != track.timescale || timescale == 0) return false;
+
+    const uint64_t mediaStart = track.duration;
+    const uint32_t samplesBefore = static_cast<uint32_t>(track.sampleSizes.size());
+
+    // Sample descriptions, mapped onto the merged stsd entries
+    const Mp4Box* stsd = stbl->child("stsd");
+    if (!stsd || stsd->children.empty()) return false;
+    std::vector<uint32_t> descriptionMap;
+    for (const auto& entry : stsd->children) {
+        auto it = std::find_if(track.descriptions.begin(), track.descriptions.end(),
+                               [&](const Mp4Box& known) { return sameBox(known, entry); });
+        if (it == track.descriptions.end()) {
+            track.descriptions.push_back(entry);
+            it = track.descriptions.end() - 1;
+        }
+        descriptionMap.push_back(static_cast<uint32_t>(it - track.descriptions.begin()) + 1);
+    }
+
+    // stsz: per-sample sizes (or one size for all)
+    const Mp4Box* stsz = stbl->child("stsz");
+    if (!stsz || stsz->payload.size() < 12) return false;
+    const uint32_t constantSize = readBE32(stsz->payload.data() + 4);
+    uint32_t sampleCount = readBE32(stsz->payload.data() + 8);
+    if (constantSize != 0) {
+        track.sampleSizes.insert(track.sampleSizes.end(), sampleCount, constantSize);
+    } else {
+        if (!tableEntries(stsz, 12, 4, sampleCount)) return false;
+        for (uint32_t i = 0; i < sampleCount; ++i) {
+            track.sampleSizes.push_back(readBE32(stsz->payload.data() + 12 + 4 * i));
+        }
+    }
+
+    // stts: decode deltas
+    uint32_t entries = 0;
+    const Mp4Box* stts = stbl->child("stts");
+    if (!tableEntries(stts, 8, 8, entries)) return false;
+    uint64_t timedSamples = 0;
+    for (uint32_t i = 0; i < entries; ++i) {
+        const uint32_t count = readBE32(stts->payload.data() + 8 + 8 * i);
+        const uint32_t delta = readBE32(stts->payload.data() + 12 + 8 * i);
+        appendRun(track.timeToSample, count, delta);
+        track.duration += static_cast<uint64_t>(count) * delta;
+        timedSamples += count;
+    }
+    if (timedSamples != sampleCount) return false;
+    if (!appendEdits(track, trak, mediaStart, track.duration - mediaStart, segmentMovieTimescale, movieTimescale)) {
+        return false;
+    }
+
+    // ctts: composition offsets (zero for segments without B-frames)
+    const Mp4Box* ctts = stbl->child("ctts");
+    if (ctts) {
+        if (!tableEntries(ctts, 8, 8, entries)) return false;
+        if (!track.hasCompositionOffsets) {
+            track.hasCompositionOffsets = true;
+            appendRun(track.compositionOffsets, samplesBefore, 0);
+        }
+        track.compositionVersion = std::max(track.compositionVersion, ctts->payload[0]);
+        for (uint32_t i = 0; i < entries; ++i) {
+            appendRun(track.compositionOffsets, readBE32(ctts->payload.data() + 8 + 8 * i),
+                      readBE32(ctts->payload.data() + 12 + 8 * i));
+        }
+    } else if (track.hasCompositionOffsets) {
+        appendRun(track.compositionOffsets, sampleCount, 0);
+    }
+
+    // stss: sync samples, renumbered (a missing stss means every sample is a sync sample)
+    const Mp4Box* stss = stbl->child("stss");
+    if (stss) {
+        if (!tableEntries(stss, 8, 4, entries)) return false;
+        if (!track.hasSyncSamples) {
+            track.hasSyncSamples = true;
+            for (uint32_t i = 1; i <= samplesBefore; ++i) track.syncSamples.push_back(i);
+        }
+        for (uint32_t i = 0; i < entries; ++i) {
+            track.syncSamples.push_back(samplesBefore + readBE32(stss->payload.data() + 8 + 4 * i));
+        }
+    } else if (track.hasSyncSamples) {
+        for (uint32_t i = 1; i <= sampleCount; ++i) track.syncSamples.push_back(samplesBefore + i);
+    }
+
+    // stco / co64: chunk offsets, moved to the output mdat
+    std::vector<uint64_t> chunkOffsets;
+    if (const Mp4Box* stco = stbl->child("stco")) {
+        if (!tableEntries(stco, 8, 4, entries)) return false;
+        for (uint32_t i = 0; i < entries; ++i) chunkOffsets.push_back(readBE32(stco->payload.data() + 8 + 4 * i));
+    } else if (const Mp4Box* co64 = stbl->child("co64")) {
+        if (!tableEntries(co64, 8, 8, entries)) return false;
+        for (uint32_t i = 0; i < entries; ++i) chunkOffsets.push_back(readBE64(co64->payload.data() + 8 + 8 * i));
+    } else {
+        return false;
+    }
+
+    // stsc: samples per chunk, expanded to one entry per chunk
+    const Mp4Box* stsc = stbl->child("stsc");
+    if (!tableEntries(stsc, 8, 12, entries)) return false;
+    uint64_t chunkedSamples = 0;
+    for (uint32_t i = 0; i < entries; ++i) {
+        const uint8_t* e = stsc->payload.data() + 8 + 12 * i;
+        const uint32_t firstChunk = readBE32(e);
+        const uint32_t lastChunk = i + 1 < entries ? readBE32(e + 12) - 1 : static_cast<uint32_t>(chunkOffsets.size());
+        const uint32_t samplesPerChunk = readBE32(e + 4);
+        const uint32_t description = readBE32(e + 8);
+        if (firstChunk == 0 || lastChunk > chunkOffsets.size() || description == 0 ||
+            description > descriptionMap.size()) {
+            return false;
+        }
+        for (uint32_t c = firstChunk; c <= lastChunk; ++c) {
+            const uint64_t offset = chunkOffsets[c - 1];
+            if (offset < data.offset || offset >= data.offset + data.size) return false;
+            track.chunks.push_back({static_cast<uint64_t>(offset + shift), samplesPerChunk, descriptionMap[description - 1]});
+            chunkedSamples += samplesPerChunk;
+        }
+    }
+    return chunkedSamples == sampleCount;
+}
+
+Mp4Box makeTable(const char* type, uint8_t version, uint32_t entryCount) {
+    Mp4Box box;
+    box.type = type;
+    box.payload = {version, 0, 0, 0};
+    appendBE32(box.payload, entryCount);
+    return box;
+}
+
+// Replaces the sample tables of an output trak with the merged ones
+bool writeTrack(Mp4Box& trak, const TrackTables& track, uint32_t movieTimescale, uint64_t& movieDuration) {
+    Mp4Box* stbl = trak.find("mdia/minf/stbl");
+    Mp4Box* mdhd = trak.find("mdia/mdhd");
+    Mp4Box* tkhd = trak.child("tkhd");
+    if (!stbl || !mdhd || !tkhd) return false;
+
+    // Durations: media timescale in mdhd, movie timescale in tkhd (edited), mvhd and elst
+    uint64_t trackDuration = track.duration * movieTimescale / track.timescale;
+    if (track.hasEdits) {
+        trackDuration = 0;
+        for (const auto& edit : track.edits) trackDuration += edit.duration;
+    }
+    movieDuration = std::max(movieDuration, trackDuration);
+    if (mdhd->payload[0] == 1) {
+        if (mdhd->payload.size() < 32) return false;
+        writeBE64(mdhd->payload.data() + 24, track.duration);
+    } else {
+        if (track.duration > 0xFFFFFFFFull) return false;
+        writeBE32(mdhd->payload.data() + 16, static_cast<uint32_t>(track.duration));
+    }
+    if (!tkhd->payload.empty() && tkhd->payload[0] == 1) {
+        if (tkhd->payload.size() < 36) return false;
+        writeBE64(tkhd->payload.data() + 28, trackDuration);
+    } else {
+        if (tkhd->payload.size() < 24 || trackDuration > 0xFFFFFFFFull) return false;
+        writeBE32(tkhd->payload.data() + 20, static_cast<uint32_t>(trackDuration));
+    }
+
+    trak.children.erase(std::remove_if(trak.children.begin(), trak.children.end(),
+                                       [](const Mp4Box& box) { return box.type == "edts"; }),
+                        trak.children.end());
+    if (track.hasEdits) {
+        Mp4Box elst = makeTable("elst", 1, static_cast<uint32_t>(track.edits.size()));
+        for (const auto& edit : track.edits) {
+            appendBE64(elst.payload, edit.duration);
+            appendBE64(elst.payload, static_cast<uint64_t>(edit.mediaTime));
+            appendBE32(elst.payload, edit.rate);
+        }
+        Mp4Box edts;
+        edts.type = "edts";
+        edts.children.push_back(std::move(elst));
+        auto afterHeader = std::find_if(trak.children.begin(), trak.children.end(),
+                                        [](const Mp4Box& box) { return box.type == "tkhd"; }) + 1;
+        trak.children.insert(afterHeader, std::move(edts));
+    }
+
+    // Per-sample tables that are not merged are dropped rather than left inconsistent
+    static const char* const kReplaced[] = {
+        "stts", "ctts", "stsz", "stz2", "stss", "stsc", "stco", "co64",
+        "sdtp", "sbgp", "sgpd", "stps", "cslg", "subs", "saiz", "saio",
+    };
+    stbl->children.erase(std::remove_if(stbl->children.begin(), stbl->children.end(), [](const Mp4Box& box) {
+                             return std::any_of(std::begin(kReplaced), std::end(kReplaced),
+                                                [&](const char* type) { return box.type == type; });
+                         }),
+                         stbl->children.end());
+
+    Mp4Box* stsd = stbl->child("stsd");
+    if (!stsd || stsd->payload.size() < 8) return false;
+    writeBE32(stsd->payload.data() + 4, static_cast<uint32_t>(track.descriptions.size()));
+    stsd->children = track.descriptions;
+
+    Mp4Box stts = makeTable("stts", 0, static_cast<uint32_t>(track.timeToSample.size()));
+    for (const auto& run : track.timeToSample) {
+        appendBE32(stts.payload, run.first);
+        appendBE32(stts.payload, run.second);
+    }
+    stbl->children.push_back(std::move(stts));
+
+    if (track.hasCompositionOffsets) {
+        Mp4Box ctts = makeTable("ctts", track.compositionVersion, static_cast<uint32_t>(track.compositionOffsets.size()));
+        for (const auto& run : track.compositionOffsets) {
+            appendBE32(ctts.payload, run.first);
+            appendBE32(ctts.payload, run.second);
+        }
+        stbl->children.push_back(std::move(ctts));
+    }
+
+    if (track.hasSyncSamples) {
+        Mp4Box stss = makeTable("stss", 0, static_cast<uint32_t>(track.syncSamples.size()));
+        for (uint32_t sample : track.syncSamples) appendBE32(stss.payload, sample);
+        stbl->children.push_back(std::move(stss));
+    }
+
+    Mp4Box stsc = makeTable("stsc", 0, 0);
+    uint32_t stscEntries = 0;
+    for (size_t i = 0; i < track.chunks.size(); ++i) {
+        const ChunkEntry& chunk = track.chunks[i];
+        if (i > 0 && chunk.samples == track.chunks[i - 1].samples &&
+            chunk.descriptionIndex == track.chunks[i - 1].descriptionIndex) {
+            continue;
+        }
+        appendBE32(stsc.payload, static_cast<uint32_t>(i + 1));
+        appendBE32(stsc.payload, chunk.samples);
+        appendBE32(stsc.payload, chunk.descriptionIndex);
+        ++stscEntries;
+    }
+    writeBE32(stsc.payload.data() + 4, stscEntries);
+    stbl->children.push_back(std::move(stsc));
+
+    const bool uniformSize = !track.sampleSizes.empty() &&
+        std::all_of(track.sampleSizes.begin(), track.sampleSizes.end(),
+                    [&](uint32_t size) { return size == track.sampleSizes.front(); });
+    Mp4Box stsz;
+    stsz.type = "stsz";
+    stsz.payload = {0, 0, 0, 0};
+    appendBE32(stsz.payload, uniformSize ? track.sampleSizes.front() : 0);
+    appendBE32(stsz.payload, static_cast<uint32_t>(track.sampleSizes.size()));
+    if (!uniformSize) {
+        for (uint32_t size : track.sampleSizes) appendBE32(stsz.payload, size);
+    }
+    stbl->children.push_back(std::move(stsz));
+
+    const bool largeOffsets = !track.chunks.empty() && std::any_of(track.chunks.begin(), track.chunks.end(),
+        [](const ChunkEntry& chunk) { return chunk.offset > 0xFFFFFFFFull; });
+    Mp4Box offsets = makeTable(largeOffsets ? "co64" : "stco", 0, static_cast<uint32_t>(track.chunks.size()));
+    for (const auto& chunk : track.chunks) {
+        if (largeOffsets) {
+            appendBE64(offsets.payload, chunk.offset);
+        } else {
+            appendBE32(offsets.payload, static_cast<uint32_t>(chunk.offset));
+        }
+    }
+    stbl->children.push_back(std::move(offsets));
+    return true;
+}
+
+bool copyRange(std::ifstream& input, uint64_t offset, uint64_t size, std::ofstream& output) {
+    std::vector<char> buffer(8 << 20);
+    input.seekg(static_cast<std::streamoff>(offset));
+    while (size > 0 && input) {
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(size, buffer.size()));
+        input.read(buffer.data(), static_cast<std::streamsize>(length));
+        if (static_cast<size_t>(input.gcount()) != length) return false;
+        output.write(buffer.data(), static_cast<std::streamsize>(length));
+        size -= length;
+    }
+    return size == 0 && output.good();
+}
+
+} // namespace
+
+bool concatenateMp4(const std::vector<std::string>& segments, const std::string& outputPath) {
+    if (segments.empty()) return false;
+
+    std::vector<uint8_t> ftyp;
+    Mp4Box moov;
+    std::vector<TrackTables> tracks;
+    std::vector<SegmentData> segmentData;
+    uint64_t outputDataSize = 0;
+    uint32_t movieTimescale = 0;
+
+    // Pass 1: merge the sample tables (only the box headers and moov of each segment are read)
+    for (size_t s = 0; s < segments.size(); ++s) {
+        FileReader file(segments[s]);
+        if (!file.opened()) {
+            std::cerr << "Error: Cannot read segment " << segments[s] << std::endl;
+            return false;
+        }
+
+        Mp4Box segmentMoov;
+        bool hasMoov = false;
+        SegmentData data;
+        std::vector<uint8_t> bytes;
+        for (const auto& box : scanMp4Boxes(file, 0, file.size())) {
+            if (box.type == "ftyp" && s == 0) {
+                if (!file.read(box.offset, static_cast<size_t>(box.size), ftyp)) break;
+            } else if (box.type == "moov") {
+                hasMoov = file.read(box.offset, static_cast<size_t>(box.size), bytes) &&
+                          parseMp4Box(bytes.data(), box.size, segmentMoov);
+            } else if (box.type == "moof") {
+                std::cerr << "Error: Fragmented segments are not supported: " << segments[s] << std::endl;
+                return false;
+            } else if (box.type == "mdat") {
+                if (data.size == 0) data.offset = box.offset + box.headerSize;
+                data.size = box.offset + box.size - data.offset;
+            }
+        }
+        if (file.failed()) {
+            std::cerr << "Error: Cannot read segment " << segments[s] << std::endl;
+            return false;
+        }
+        if (!hasMoov || data.size == 0) {
+            std::cerr << "Error: Segment has no moov or mdat: " << segments[s] << std::endl;
+            return false;
+        }
+
+        const uint32_t segmentMovieTimescale = movieTimescaleOf(segmentMoov);
+        if (segmentMovieTimescale == 0) {
+            std::cerr << "Error: Segment has no movie header: " << segments[s] << std::endl;
+            return false;
+        }
+        std::vector<const Mp4Box*> traks;
+        for (const auto& child : segmentMoov.children) {
+            if (child.type == "trak") traks.push_back(&child);
+        }
+        if (s == 0) {
+            moov = segmentMoov;
+            movieTimescale = segmentMovieTimescale;
+            tracks.resize(traks.size());
+            for (size_t t = 0; t < traks.size(); ++t) tracks[t].handler = handlerType(*traks[t]);
+        }
+        if (traks.size() != tracks.size()) {
+            std::cerr << "Error: Segment track layout differs: " << segments[s] << std::endl;
+            return false;
+        }
+
+        // Offsets are relative to the output file: ftyp, 16-byte mdat header, previous segments
+        const int64_t shift = static_cast<int64_t>(ftyp.size() + 16 + outputDataSize) - static_cast<int64_t>(data.offset);
+        for (size_t t = 0; t < traks.size(); ++t) {
+            if (handlerType(*traks[t]) != tracks[t].handler || !appendTrack(tracks[t], *traks[t], data, shift, segmentMovieTimescale, movieTimescale)) {
+                std::cerr << "Error: Cannot merge track " << t << " of " << segments[s] << std::endl;
+                return false;
+            }
+        }
+        segmentData.push_back(data);
+        outputDataSize += data.size;
+    }
+
+    // Rewrite the first segment's moov with the merged tables
+    Mp4Box* mvhd = moov.child("mvhd");
+    const bool mvhdV1 = mvhd->payload[0] == 1;
+    uint64_t movieDuration = 0;
+    size_t trackIndex = 0;
+    for (auto& child : moov.children) {
+        if (child.type != "trak") continue;
+        if (!writeTrack(child, tracks[trackIndex++], movieTimescale, movieDuration)) {
+            std::cerr << "Error: Cannot rewrite sample tables of track " << trackIndex - 1 << std::endl;
+            return false;
+        }
+    }
+    if (mvhdV1) {
+        writeBE64(mvhd->payload.data() + 24, movieDuration);
+    } else {
+        writeBE32(mvhd->payload.data() + 16, static_cast<uint32_t>(std::min<uint64_t>(movieDuration, 0xFFFFFFFFull)));
+    }
+
+    // Pass 2: ftyp, one mdat with a 64-bit size, then moov
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "Error: Cannot create " << outputPath << std::endl;
+        return false;
+    }
+    output.write(reinterpret_cast<const char*>(ftyp.data()), static_cast<std::streamsize>(ftyp.size()));
+
+    std::vector<uint8_t> mdatHeader;
+    appendBE32(mdatHeader, 1);
+    mdatHeader.insert(mdatHeader.end(), {'m', 'd', 'a', 't'});
+    appendBE64(mdatHeader, 16 + outputDataSize);
+    output.write(reinterpret_cast<const char*>(mdatHeader.data()), static_cast<std::streamsize>(mdatHeader.size()));
+
+    for (size_t s = 0; s < segments.size(); ++s) {
+        std::ifstream input(segments[s], std::ios::binary);
+        if (!copyRange(input, segmentData[s].offset, segmentData[s].size, output)) {
+            std::cerr << "Error: Failed to copy sample data of " << segments[s] << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> moovBytes;
+    appendMp4Box(moovBytes, moov);
+    output.write(reinterpret_cast<const char*>(moovBytes.data()), static_cast<std::streamsize>(moovBytes.size()));
+    output.close();
+    return !output.fail();
+}
@@ -0,0 +1,23 @@
+#ifndef MP4_CONCAT_H
+#define MP4_CONCAT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Joins MP4 segments encoded with the same settings into one file without re-encoding.
+ *
+ * The sample data of every segment is copied as-is into a single mdat, and the moov of
+ * the first segment is rewritten with the merged sample tables of each track (stts, ctts,
+ * stsz, stss, stsc, and stco or co64 when offsets pass 4 GB). Sample descriptions that
+ * differ between segments are kept as separate stsd entries. The edit lists of the
+ * segments are chained, so each segment presents the same media as on its own: the AAC
+ * priming samples at the start of every segment's audio stay cut, and edits that follow
+ * each other without a gap (the video B-frame delay) are merged into one. The output is
+ * laid out as ftyp, mdat, moov.
+ *
+ * @return false (with a message on stderr) if the segments do not have the same tracks
+ */
+bool concatenateMp4(const std::vector<std::string>& segments, const std::string& outputPath);
+
+#endif // MP4_CONCAT_H
@@ -0,0 +1,393 @@
+#include "rendition_ladder.h"
+#include "jpeg_io.h"
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RENDITION_HAVE_X86 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Filter contributions of the source samples to each output sample along one axis
+struct AxisWeights {
+    std::vector<int> first;     // Offset into indices/weights for each output sample
+    std::vector<int> count;     // Number of taps for each output sample
+    std::vector<int> indices;   // Source sample index of each tap (already wrapped/clamped)
+    std::vector<float> weights; // Normalized weight of each tap
+    int maxTaps = 0;
+};
+
+// Tent filter widened by the scale factor when downscaling (area-like antialiasing)
+AxisWeights computeAxisWeights(int inSize, int outSize, bool wrap) {
+    AxisWeights axis;
+    const double scale = static_cast<double>(inSize) / outSize;
+    const double filterScale = std::max(1.0, scale);
+    const double support = filterScale;
+
+    axis.first.resize(outSize);
+    axis.count.resize(outSize);
+
+    for (int o = 0; o < outSize; ++o) {
+        const double center = (o + 0.5) * scale - 0.5;
+        const int left = static_cast<int>(std::ceil(center - support));
+        const int right = static_cast<int>(std::floor(center + support));
+
+        const int start = static_cast<int>(axis.weights.size());
+        double total = 0.0;
+        for (int i = left; i <= right; ++i) {
+            const double w = 1.0 - std::fabs((i - center) / filterScale);
+            if (w <= 0.0) continue;
+
+            int index = i;
+            if (wrap) {
+                index = ((i % inSize) + inSize) % inSize;
+            } else {
+                index = std::clamp(i, 0, inSize - 1);
+            }
+            axis.indices.push_back(index);
+            axis.weights.push_back(static_cast<float>(w));
+            total += w;
+        }
+
+        const int taps = static_cast<int>(axis.weights.size()) - start;
+        for (int t = start; t < start + taps; ++t) {
+            axis.weights[t] = static_cast<float>(axis.weights[t] / total);
+        }
+        axis.first[o] = start;
+        axis.count[o] = taps;
+        axis.maxTaps = std::max(axis.maxTaps, taps);
+    }
+    return axis;
+}
+
+// Horizontal pass: one RGBX float row in, one RGBX float row out (4 floats per pixel)
+void resampleRow(const float* src, float* dst, const AxisWeights& axis, int outWidth) {
+    for (int x = 0; x < outWidth; ++x) {
+        const int* idx = &axis.indices[axis.first[x]];
+        const float* w = &axis.weights[axis.first[x]];
+        const int taps = axis.count[x];
+#ifdef RENDITION_HAVE_X86
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < taps; ++t) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src + 4 * idx[t]), _mm_set1_ps(w[t])));
+        }
+        _mm_storeu_ps(dst + 4 * x, acc);
+#else
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+        for (int t = 0; t < taps; ++t) {
+            const float* p = src + 4 * idx[t];
+            r += p[0] * w[t];
+            g += p[1] * w[t];
+            b += p[2] * w[t];
+        }
+        dst[4 * x] = r;
+        dst[4 * x + 1] = g;
+        dst[4 * x + 2] = b;
+        dst[4 * x + 3] = 0.0f;
+#endif
+    }
+}
+
+// Vertical pass: dst[i] = sum(w[k] * rows[k][i])
+void accumulateRowsScalar(float* dst, const float* const* rows, const float* w, int taps, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        float acc = 0.0f;
+        for (int k = 0; k < taps; ++k) {
+            acc += rows[k][i] * w[k];
+        }
+        dst[i] = acc;
+    }
+}
+
+#ifdef RENDITION_HAVE_X86
+__attribute__((target("avx2,fma")))
+void accumulateRowsAvx2(float* dst, const float* const* rows, const float* w, int taps, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int k = 0; k < taps; ++k) {
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(w[k]), acc);
+        }
+        _mm256_storeu_ps(dst + i, acc);
+    }
+    accumulateRowsScalar(dst + i, rows, w, taps, n - i);
+}
+
+void accumulateRowsSse(float* dst, const float* const* rows, const float* w, int taps, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < taps; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(w[k])));
+        }
+        _mm_storeu_ps(dst + i, acc);
+    }
+    // Tail: offset the row pointers so the scalar loop starts at i
+    std::vector<const float*> tail(rows, rows + taps);
+    for (auto& row : tail) row += i;
+    accumulateRowsScalar(dst + i, tail.data(), w, taps, n - i);
+}
+#endif
+
+using AccumulateFn = void (*)(float*, const float* const*, const float*, int, size_t);
+
+AccumulateFn selectAccumulate() {
+#ifdef RENDITION_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return accumulateRowsAvx2;
+    }
+    return accumulateRowsSse;
+#else
+    return accumulateRowsScalar;
+#endif
+}
+
+// Streaming resampler + encoder for one rendition
+class RenditionWriter {
+public:
+    RenditionWriter(const RenditionSpec& spec, int srcWidth, int srcHeight, const std::string& path,
+                    const RenditionMetadataFn& metadata)
+        : spec_(spec), path_(path), tmpPath_(path + ".tmp"),
+          outWidth_(spec.width), outHeight_(spec.height > 0 ? spec.height : spec.width / 2),
+          hAxis_(computeAxisWeights(srcWidth, outWidth_, true)),
+          vAxis_(computeAxisWeights(srcHeight, outHeight_, false)) {
+
+        ringSize_ = vAxis_.maxTaps + 1;
+        ring_.assign(static_cast<size_t>(ringSize_) * outWidth_ * 4, 0.0f);
+        ringRow_.assign(ringSize_, -1);
+        accum_.resize(static_cast<size_t>(outWidth_) * 4);
+        scanline_.resize(static_cast<size_t>(outWidth_) * 3);
+
+        file_ = std::fopen(tmpPath_.c_str(), "wb");
+        if (!file_) {
+            throw std::runtime_error("cannot create " + tmpPath_);
+        }
+
+        // The destructor does not run for a constructor that throws
+        try {
+            const std::vector<JpegSegment> segments =
+                metadata ? metadata(outWidth_, outHeight_) : std::vector<JpegSegment>();
+            cinfo_.err = initJpegErrorManager(jerr_);
+            jpegCall(jerr_, [&] {
+                jpeg_create_compress(&cinfo_);
+                jpeg_stdio_dest(&cinfo_, file_);
+                cinfo_.image_width = outWidth_;
+                cinfo_.image_height = outHeight_;
+                cinfo_.input_components = 3;
+                cinfo_.in_color_space = JCS_RGB;
+                jpeg_set_defaults(&cinfo_);
+                jpeg_set_quality(&cinfo_, spec.quality, TRUE);
+                cinfo_.optimize_coding = TRUE;
+                jpeg_start_compress(&cinfo_, TRUE);
+
+                for (size_t i = 0; i < segments.size(); ++i) {
+                    jpeg_write_marker(&cinfo_, segments[i].marker, segments[i].payload.data(),
+                                      static_cast<unsigned int>(segments[i].payload.size()));
+                }
+            });
+        } catch (...) {
+            discard();
+            throw;
+        }
+    }
+
+    ~RenditionWriter() {
+        discard();
+    }
+
+    RenditionWriter(const RenditionWriter&) = delete;
+    RenditionWriter& operator=(const RenditionWriter&) = delete;
+
+    // Feed decoded source row y (RGBX floats); emits every output row that became complete
+    void pushRow(int y, const float* srcRow, AccumulateFn accumulate) {
+        float* slot = &ring_[static_cast<size_t>(y % ringSize_) * outWidth_ * 4];
+        resampleRow(srcRow, slot, hAxis_, outWidth_);
+        ringRow_[y % ringSize_] = y;
+
+        while (nextOutRow_ < outHeight_ && lastSourceRow(nextOutRow_) <= y) {
+            emitRow(nextOutRow_, accumulate);
+            ++nextOutRow_;
+        }
+    }
+
+    RenditionResult finish() {
+        jpegCall(jerr_, [&] { jpeg_finish_compress(&cinfo_); });
+        const bool closed = std::fclose(file_) == 0;
+        file_ = nullptr;
+        std::error_code ec;
+        if (closed) {
+            fs::rename(tmpPath_, path_, ec);
+        }
+        if (!closed || ec) {
+            fs::remove(tmpPath_, ec);
+            throw std::runtime_error("cannot write " + path_);
+        }
+        return {spec_.name, path_, outWidth_, outHeight_, true};
+    }
+
+private:
+    // Releases the encoder and removes the unfinished temporary file, if any
+    void discard() {
+        jpeg_destroy_compress(&cinfo_);
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+            std::error_code ec;
+            fs::remove(tmpPath_, ec);
+        }
+    }
+
+    int lastSourceRow(int outRow) const {
+        int last = 0;
+        for (int t = 0; t < vAxis_.count[outRow]; ++t) {
+            last = std::max(last, vAxis_.indices[vAxis_.first[outRow] + t]);
+        }
+        return last;
+    }
+
+    void emitRow(int outRow, AccumulateFn accumulate) {
+        const int taps = vAxis_.count[outRow];
+        const int first = vAxis_.first[outRow];
+
+        rowPtrs_.resize(taps);
+        for (int t = 0; t < taps; ++t) {
+            const int srcRow = vAxis_.indices[first + t];
+            if (ringRow_[srcRow % ringSize_] != srcRow) {
+                throw std::runtime_error("rendition ring buffer underflow");
+            }
+            rowPtrs_[t] = &ring_[static_cast<size_t>(srcRow % ringSize_) * outWidth_ * 4];
+        }
+        accumulate(accum_.data(), rowPtrs_.data(), &vAxis_.weights[first], taps, accum_.size());
+
+        for (int x = 0; x < outWidth_; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                const float v = accum_[4 * x + c] + 0.5f;
+                scanline_[3 * x + c] = static_cast<JSAMPLE>(std::clamp(v, 0.0f, 255.0f));
+            }
+        }
+        JSAMPROW row = scanline_.data();
+        jpegCall(jerr_, [&] { jpeg_write_scanlines(&cinfo_, &row, 1); });
+    }
+
+    RenditionSpec spec_;
+    std::string path_;
+    std::string tmpPath_;
+    int outWidth_;
+    int outHeight_;
+    AxisWeights hAxis_;
+    AxisWeights vAxis_;
+
+    int ringSize_ = 0;
+    std::vector<float> ring_;     // ringSize_ horizontally filtered rows
+    std::vector<int> ringRow_;    // Source row held by each ring slot
+    std::vector<float> accum_;
+    std::vector<const float*> rowPtrs_;
+    std::vector<JSAMPLE> scanline_;
+    int nextOutRow_ = 0;
+
+    FILE* file_ = nullptr;
+    jpeg_compress_struct cinfo_{};
+    JpegErrorManager jerr_;
+};
+
+} // namespace
+
+std::vector<RenditionSpec> defaultRenditionLadder() {
+    return {
+        {"8k", 7680, 3840, 90},
+        {"4k", 3840, 1920, 88},
+        {"2k", 2048, 1024, 85},
+        {"thumb", 512, 256, 80},
+    };
+}
+
+std::vector<RenditionResult> generateRenditions(const std::string& sourcePath,
+                                                const std::string& outputDir,
+                                                const std::vector<RenditionSpec>& ladder,
+                                                const RenditionMetadataFn& metadata) {
+    std::vector<RenditionResult> results;
+
+    FILE* input = std::fopen(sourcePath.c_str(), "rb");
+    if (!input) {
+        std::cerr << "Error: Cannot open stitched image for renditions: " << sourcePath << std::endl;
+        return results;
+    }
+
+    jpeg_decompress_struct dinfo{};
+    JpegErrorManager jerr;
+    dinfo.err = initJpegErrorManager(jerr);
+
+    try {
+        jpegCall(jerr, [&] {
+            jpeg_create_decompress(&dinfo);
+            jpeg_stdio_src(&dinfo, input);
+            jpeg_read_header(&dinfo, TRUE);
+            dinfo.out_color_space = JCS_RGB;
+            jpeg_start_decompress(&dinfo);
+        });
+
+        const int srcWidth = static_cast<int>(dinfo.output_width);
+        const int srcHeight = static_cast<int>(dinfo.output_height);
+        std::cout << "🖼️ Generating renditions from " << srcWidth << "x" << srcHeight << " source..." << std::endl;
+
+        fs::create_directories(outputDir);
+        const std::string stem = fs::path(sourcePath).stem().string();
+
+        std::vector<std::unique_ptr<RenditionWriter>> writers;
+        for (const auto& spec : ladder) {
+            // Both dimensions must shrink: a custom height or a non-2:1 source must never upscale
+            const int height = spec.height > 0 ? spec.height : spec.width / 2;
+            if (spec.width <= 0 || spec.width >= srcWidth || height <= 0 || height >= srcHeight) {
+                std::cout << "  Skipping rendition " << spec.name << " (" << spec.width << "x" << height
+                          << " is not smaller than the source)" << std::endl;
+                continue;
+            }
+            const std::string path = (fs::path(outputDir) / (stem + "_" + spec.name + ".jpg")).string();
+            writers.push_back(std::make_unique<RenditionWriter>(spec, srcWidth, srcHeight, path, metadata));
+        }
+
+        const AccumulateFn accumulate = selectAccumulate();
+        std::vector<JSAMPLE> decoded(static_cast<size_t>(srcWidth) * 3);
+        std::vector<float> srcRow(static_cast<size_t>(srcWidth) * 4, 0.0f);
+
+        while (dinfo.output_scanline < dinfo.output_height) {
+            const int y = static_cast<int>(dinfo.output_scanline);
+            JSAMPROW row = decoded.data();
+            jpegCall(jerr, [&] { jpeg_read_scanlines(&dinfo, &row, 1); });
+
+            // Widen once to RGBX floats, shared by every rendition
+            for (int x = 0; x < srcWidth; ++x) {
+                srcRow[4 * x] = decoded[3 * x];
+                srcRow[4 * x + 1] = decoded[3 * x + 1];
+                srcRow[4 * x + 2] = decoded[3 * x + 2];
+            }
+            for (auto& writer : writers) {
+                writer->pushRow(y, srcRow.data(), accumulate);
+            }
+        }
+        jpegCall(jerr, [&] { jpeg_finish_decompress(&dinfo); });
+
+        for (auto& writer : writers) {
+            RenditionResult result = writer->finish();
+            std::cout << "  Rendition " << result.name << ": " << result.width << "x" << result.height
+                      << " -> " << fs::path(result.path).filename() << std::endl;
+            results.push_back(result);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error generating renditions: " << e.what() << std::endl;
+        results.clear();
+    }
+
+    jpeg_destroy_decompress(&dinfo);
+    std::fclose(input);
+    return results;
+}
@@ -0,0 +1,60 @@
+#ifndef RENDITION_LADDER_H
+#define RENDITION_LADDER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "jpeg_metadata.h"
+
+// One rung of the rendition ladder (e.g. "4k" -> 3840x1920)
+struct RenditionSpec {
+    std::string name;
+    int width;
+    int height;   // 0 = keep the 2:1 equirectangular ratio (width / 2)
+    int quality;  // JPEG quality (1-100)
+};
+
+// Produces the metadata segments (EXIF/XMP) of a rendition of the given size
+using RenditionMetadataFn = std::function<std::vector<JpegSegment>(int width, int height)>;
+
+// Outcome of a single rendition
+struct RenditionResult {
+    std::string name;
+    std::string path;
+    int width;
+    int height;
+    bool success;
+};
+
+/**
+ * Default ladder used by the batch processor: 8K, 4K, 2K and a 512px thumbnail.
+ */
+std::vector<RenditionSpec> defaultRenditionLadder();
+
+/**
+ * Decodes the stitched equirectangular JPEG once and produces every rendition of the
+ * ladder in a single streaming pass.
+ *
+ * Each rendition is resampled with a separable (horizontal then vertical) filter that
+ * consumes the decoded image row by row: only one decoded source row plus a small ring
+ * of filtered rows per rendition is kept in memory, never a full-size frame. The inner
+ * loops use SSE/AVX2 when available and fall back to scalar code otherwise.
+ * Horizontal taps wrap around the image edges since equirectangular images are seamless.
+ *
+ * Renditions are written as <outputDir>/<source stem>_<name>.jpg. Rungs that are not
+ * smaller than the source image are skipped (no upscaling). When a metadata callback is
+ * given, its segments are written by the encoder itself, so no rendition is rewritten
+ * afterwards to add 360° metadata.
+ *
+ * @param sourcePath Path to the stitched equirectangular JPEG
+ * @param outputDir Directory receiving the renditions (created if needed)
+ * @param ladder Renditions to produce
+ * @param metadata Optional metadata segments for each rendition
+ * @return One result per produced rendition
+ */
+std::vector<RenditionResult> generateRenditions(const std::string& sourcePath,
+                                                const std::string& outputDir,
+                                                const std::vector<RenditionSpec>& ladder,
+                                                const RenditionMetadataFn& metadata = RenditionMetadataFn());
+
+#endif // RENDITION_LADDER_H
@@ -1,141 +1,228 @@
 #include "resolution_detector.h"
-#include <exiv2/exiv2.hpp>
 #include <iostream>
+#include <fstream>
 #include <algorithm>
-#include <map>
+#include <cctype>
+#include <cmath>
+#include <vector>
 #include <iomanip>
+#include <json/json.h>
+
+namespace {
+
+// Static description of an Insta360 camera
+struct CameraModelSpec {
+    const char* name;
+    const char* aliases[3];  // Normalized names (see normalizeModelName)
+    int photoWidth;
+    int photoHeight;
+    int videoWidth;          // Largest stitched 360 video
+    int videoHeight;
+};
 
 // Resolution database by Insta360 model
-std::map<std::string, ResolutionInfo> MODEL_RESOLUTIONS = {
-    // Insta360 X4 - Latest model (8K)
-    {"Insta360 X4", {11904, 5952, "Insta360 X4"}},
-    {"X4", {11904, 5952, "Insta360 X4"}},
-    
-    // Insta360 X3 - Popular model (5.7K)
-    {"Insta360 X3", {11520, 5760, "Insta360 X3"}},
-    {"X3", {11520, 5760, "Insta360 X3"}},
-    
-    // Insta360 X2 - Previous generation (5.7K)
-    {"Insta360 ONE X2", {11520, 5760, "Insta360 ONE X2"}},
-    {"ONE X2", {11520, 5760, "Insta360 ONE X2"}},
-    {"X2", {11520, 5760, "Insta360 ONE X2"}},
-    
-    // Insta360 ONE X - First generation (5.7K)
-    {"Insta360 ONE X", {11520, 5760, "Insta360 ONE X"}},
-    {"ONE X", {11520, 5760, "Insta360 ONE X"}},
-    
-    // Insta360 ONE R - Modular (5.3K)
-    {"Insta360 ONE R", {10560, 5280, "Insta360 ONE R"}},
-    {"ONE R", {10560, 5280, "Insta360 ONE R"}},
-    
-    // Insta360 ONE RS - Enhanced version (6K)
-    {"Insta360 ONE RS", {12000, 6000, "Insta360 ONE RS"}},
-    {"ONE RS", {12000, 6000, "Insta360 ONE RS"}},
-    
-    // Older models
-    {"Insta360 ONE", {7680, 3840, "Insta360 ONE"}},
-    {"ONE", {7680, 3840, "Insta360 ONE"}},
-    
-    // Default fallback (X4 as reference)
-    {"Unknown", {11904, 5952, "Unknown Model (X4 Default)"}},
+constexpr CameraModelSpec kCameraModels[] = {
+    {"Insta360 X4", {"x4"}, 11904, 5952, 7680, 3840},              // 8K
+    {"Insta360 X3", {"x3"}, 11520, 5760, 5760, 2880},              // 5.7K
+    {"Insta360 ONE X2", {"onex2", "x2"}, 11520, 5760, 5760, 2880}, // 5.7K
+    {"Insta360 ONE X", {"onex"}, 11520, 5760, 5760, 2880},         // 5.7K
+    {"Insta360 ONE R", {"oner"}, 10560, 5280, 5760, 2880},         // 5.3K photos
+    {"Insta360 ONE RS", {"oners"}, 12000, 6000, 5760, 2880},       // 6K photos
+    {"Insta360 ONE", {"one"}, 7680, 3840, 3840, 1920},             // 4K
 };
 
-std::string extractCameraModel(const std::string& file_path) {
-    try {
-        auto image = Exiv2::ImageFactory::open(file_path);
-        if (!image.get()) {
-            std::cerr << "Warning: Cannot open image for model detection: " << file_path << std::endl;
-            return "Unknown";
+// Default fallback (X4 as reference)
+constexpr CameraModelSpec kUnknownModel = {"Unknown Model (X4 Default)", {}, 11904, 5952, 7680, 3840};
+
+CameraModel toModel(const CameraModelSpec& spec) {
+    CameraModel model{spec.name, {}, spec.photoWidth, spec.photoHeight, spec.videoWidth, spec.videoHeight};
+    for (const char* alias : spec.aliases) {
+        if (alias) model.aliases.push_back(alias);
+    }
+    return model;
+}
+
+// Exact match of the normalized name against the model names and aliases
+bool findModel(const std::string& name, const CameraModelTable& overrides, CameraModel& result) {
+    const std::string key = normalizeModelName(name);
+    if (key.empty()) return false;
+
+    for (const auto& model : overrides) {
+        if (normalizeModelName(model.name) == key ||
+            std::find(model.aliases.begin(), model.aliases.end(), key) != model.aliases.end()) {
+            result = model;
+            return true;
+        }
+    }
+    for (const auto& spec : kCameraModels) {
+        CameraModel model = toModel(spec);
+        if (normalizeModelName(model.name) == key ||
+            std::find(model.aliases.begin(), model.aliases.end(), key) != model.aliases.end()) {
+            result = model;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::string normalizeModelName(const std::string& name) {
+    std::string normalized;
+    for (char c : name) {
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+            normalized += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
         }
+    }
+    const std::string brand = "insta360";
+    if (normalized.compare(0, brand.size(), brand) == 0) {
+        normalized.erase(0, brand.size());
+    }
+    return normalized;
+}
+
+CameraModelTable loadCameraModelOverrides(const std::string& path) {
+    CameraModelTable models;
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Warning: Cannot open camera models file: " << path << std::endl;
+        return models;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &root, &errors) || !root["models"].isArray()) {
+        std::cerr << "Warning: Invalid camera models file " << path << ": " << errors << std::endl;
+        return models;
+    }
 
-        image->readMetadata();
-        Exiv2::ExifData& exifData = image->exifData();
-        
-        // Search for model in different EXIF fields
-        std::vector<std::string> model_tags = {
-            "Exif.Image.Model",
-            "Exif.Image.Make", 
-            "Exif.Photo.CameraOwnerName",
-            "Exif.Iop.InteroperabilityIndex"
-        };
-        
-        for (const auto& tag : model_tags) {
-            auto it = exifData.findKey(Exiv2::ExifKey(tag));
-            if (it != exifData.end()) {
-                std::string model = it->print();
-                
-                // Clean and normalize model name
-                std::transform(model.begin(), model.end(), model.begin(), ::tolower);
-                
-                // Detection by keywords
-                if (model.find("x4") != std::string::npos) return "Insta360 X4";
-                if (model.find("x3") != std::string::npos) return "Insta360 X3";
-                if (model.find("x2") != std::string::npos || model.find("one x2") != std::string::npos) return "Insta360 ONE X2";
-                if (model.find("one x") != std::string::npos && model.find("x2") == std::string::npos) return "Insta360 ONE X";
-                if (model.find("one r") != std::string::npos && model.find("rs") == std::string::npos) return "Insta360 ONE R";
-                if (model.find("one rs") != std::string::npos || model.find("oners") != std::string::npos) return "Insta360 ONE RS";
-                if (model.find("one") != std::string::npos && model.find("x") == std::string::npos && model.find("r") == std::string::npos) return "Insta360 ONE";
-                
-                // If we find "insta360", return the complete model
-                if (model.find("insta360") != std::string::npos) {
-                    return it->print(); // Return original name
-                }
-            }
+    for (const auto& entry : root["models"]) {
+        CameraModel model{entry["name"].asString(), {},
+                          entry.get("photoWidth", 0).asInt(), entry.get("photoHeight", 0).asInt(),
+                          entry.get("videoWidth", 0).asInt(), entry.get("videoHeight", 0).asInt()};
+        if (model.name.empty() || model.photoWidth <= 0 || model.photoHeight <= 0) {
+            std::cerr << "Warning: Skipping camera model entry without name or photo size" << std::endl;
+            continue;
         }
-        
-        // Try to detect via metadata resolution
-        auto width_it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.PixelXDimension"));
-        auto height_it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.PixelYDimension"));
-        
-        if (width_it != exifData.end() && height_it != exifData.end()) {
-            int width = width_it->toLong();
-            int height = height_it->toLong();
-            
-            // Deduction by resolution
-            if (width >= 11900) return "Insta360 X4";      // 8K
-            if (width >= 11500) return "Insta360 X3";      // 5.7K
-            if (width >= 12000 && height >= 6000) return "Insta360 ONE RS"; // 6K
-            if (width >= 10500) return "Insta360 ONE R";   // 5.3K
-            if (width >= 7680) return "Insta360 ONE";      // 4K
+        for (const auto& alias : entry["aliases"]) {
+            model.aliases.push_back(normalizeModelName(alias.asString()));
         }
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Warning: EXIF reading error: " << e.what() << std::endl;
+        models.push_back(std::move(model));
     }
-    
-    return "Unknown";
+
+    std::cout << "📷 Loaded " << models.size() << " camera model(s) from " << path << std::endl;
+    return models;
 }
 
-ResolutionInfo getResolutionForModel(const std::string& model_name) {
-    auto it = MODEL_RESOLUTIONS.find(model_name);
-    if (it != MODEL_RESOLUTIONS.end()) {
-        return it->second;
+std::string extractCameraModel(const MediaMetadata& metadata, const CameraModelTable& overrides) {
+    if (!metadata.valid) {
+        std::cerr << "Warning: No EXIF metadata for model detection: " << metadata.path << std::endl;
+        return "Unknown";
     }
-    
-    // Fuzzy search for name variants
-    for (const auto& [key, resolution] : MODEL_RESOLUTIONS) {
-        if (model_name.find(key) != std::string::npos || key.find(model_name) != std::string::npos) {
-            return resolution;
+
+    // Search for model in the identification fields (Model first, Make as a fallback)
+    CameraModel model;
+    for (const std::string& field : {metadata.model, metadata.make}) {
+        if (field.empty()) continue;
+        if (findModel(field, overrides, model)) return model.name;
+
+        // Insta360 camera missing from the table: return the complete model
+        std::string lower = field;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.find("insta360") != std::string::npos && !normalizeModelName(field).empty()) {
+            return field;
         }
     }
-    
+
+    // Try to detect via photo resolution (video track sizes are per lens, not comparable)
+    if (metadata.durationSeconds == 0.0 && metadata.width > 0 && metadata.height > 0) {
+        int width = metadata.width;
+        int height = metadata.height;
+
+        // Deduction by resolution, largest first
+        if (width >= 12000 && height >= 6000) return "Insta360 ONE RS"; // 6K
+        if (width >= 11900) return "Insta360 X4";      // 8K
+        if (width >= 11500) return "Insta360 X3";      // 5.7K
+        if (width >= 10500) return "Insta360 ONE R";   // 5.3K
+        if (width >= 7680) return "Insta360 ONE";      // 4K
+    }
+
+    return "Unknown";
+}
+
+ResolutionInfo getResolutionForModel(const std::string& model_name, const CameraModelTable& overrides) {
+    CameraModel model;
+    if (findModel(model_name, overrides, model)) {
+        return {model.photoWidth, model.photoHeight, model.name};
+    }
+
     // Fallback to X4 (highest resolution)
     std::cout << "Warning: Unknown model '" << model_name << "', using X4 default resolution" << std::endl;
-    return MODEL_RESOLUTIONS["Unknown"];
+    return {kUnknownModel.photoWidth, kUnknownModel.photoHeight, kUnknownModel.name};
 }
 
-ResolutionInfo detectOptimalResolution(const std::string& input_file_path) {
+ResolutionInfo detectOptimalResolution(const MediaMetadata& metadata, const CameraModelTable& overrides) {
     std::cout << "🔍 Detecting camera model and optimal resolution..." << std::endl;
-    
-    std::string detected_model = extractCameraModel(input_file_path);
-    ResolutionInfo resolution = getResolutionForModel(detected_model);
-    
+
+    std::string detected_model = extractCameraModel(metadata, overrides);
+    ResolutionInfo resolution = getResolutionForModel(detected_model, overrides);
+
     std::cout << "📷 Detected Model: " << resolution.model_name << std::endl;
     std::cout << "📐 Optimal Resolution: " << resolution.width << "x" << resolution.height << std::endl;
-    
+
     // Calculate megapixels for information
     double megapixels = (resolution.width * resolution.height) / 1000000.0;
     std::cout << "🎯 Output Quality: " << std::fixed << std::setprecision(1) << megapixels << " MP" << std::endl;
-    
+
     return resolution;
-}
\ No newline at end of file
+}
+
+ResolutionInfo detectOptimalResolution(const std::string& input_file_path) {
+    return detectOptimalResolution(readMediaMetadata(input_file_path));
+}
+
+VideoOutputInfo detectVideoOutput(const MediaMetadata& metadata, int maxWidth, int maxHeight, int referenceBitrate,
+                                  const CameraModelTable& overrides) {
+    constexpr int kMinBitrate = 5000000;
+
+    VideoOutputInfo output{maxWidth, maxHeight, referenceBitrate, "Unknown"};
+    int width = std::min(maxWidth, 2 * maxHeight);
+
+    // Native size: dual-fisheye tracks are side by side (2:1) or one square lens per track
+    const int nativeWidth = std::max(metadata.width, 2 * metadata.height);
+    if (nativeWidth > 0) {
+        width = std::min(width, nativeWidth);
+    }
+
+    CameraModel model;
+    const std::string modelName = extractCameraModel(metadata, overrides);
+    if (findModel(modelName, overrides, model) && model.videoWidth > 0) {
+        output.model_name = model.name;
+        width = std::min(width, model.videoWidth);
+    } else if (modelName != "Unknown") {
+        output.model_name = modelName;
+    }
+
+    if (nativeWidth == 0 && output.model_name == "Unknown") {
+        std::cout << "📐 Video size unknown, using configured " << maxWidth << "x" << maxHeight << std::endl;
+        return output;
+    }
+
+    // 2:1 frame, both sides multiples of 16 for the encoder
+    output.width = std::max(32, width / 32 * 32);
+    output.height = output.width / 2;
+
+    // Scale the bitrate by pixel count against the configured frame (at most 8K)
+    const double referencePixels = static_cast<double>(std::min(maxWidth, kUnknownModel.videoWidth)) *
+                                   std::min(maxHeight, kUnknownModel.videoHeight);
+    const double ratio = std::min(1.0, static_cast<double>(output.width) * output.height / referencePixels);
+    output.bitrate = std::max(std::min(kMinBitrate, referenceBitrate),
+                              static_cast<int>(std::lround(referenceBitrate * ratio)));
+
+    std::cout << "📷 Video Model: " << output.model_name << " (native " << metadata.width << "x"
+              << metadata.height << ")" << std::endl;
+    std::cout << "📐 Video Output: " << output.width << "x" << output.height << " @ "
+              << output.bitrate / 1000000.0 << " Mbps" << std::endl;
+    return output;
+}
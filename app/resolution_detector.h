@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include <utility>
+#include <vector>
+#include "media_metadata.h"
 
 // Structure to store resolution information
 struct ResolutionInfo {
@@ -9,18 +11,68 @@ struct ResolutionInfo {
     std::string model_name;
 };
 
+// A camera model and its native sizes
+struct CameraModel {
+    std::string name;
+    std::vector<std::string> aliases; // Normalized names (see normalizeModelName)
+    int photoWidth;
+    int photoHeight;
+    int videoWidth;                   // Largest stitched 360 video (0 = unknown)
+    int videoHeight;
+};
+
+// Extra or corrected models, checked before the built-in table. Loaded once and then only
+// read, so worker threads can share a const reference without locking.
+using CameraModelTable = std::vector<CameraModel>;
+
+// Output size and bitrate chosen for one video
+struct VideoOutputInfo {
+    int width;
+    int height;
+    int bitrate;
+    std::string model_name;
+};
+
 /**
  * Automatically detects optimal resolution according to camera model
- * by analyzing EXIF metadata from source file
+ * using the metadata snapshot of the source file
+ */
+ResolutionInfo detectOptimalResolution(const MediaMetadata& metadata, const CameraModelTable& overrides = {});
+
+/**
+ * Convenience overload that reads the snapshot of the source file first
  */
 ResolutionInfo detectOptimalResolution(const std::string& input_file_path);
 
+/**
+ * Chooses the stitched size and bitrate of a video from its native size and camera model,
+ * so a 5.7K clip is not up-scaled to 8K. The result never exceeds maxWidth x maxHeight;
+ * referenceBitrate is the bitrate for that maximum frame (capped to 8K) and is scaled by
+ * the pixel count.
+ */
+VideoOutputInfo detectVideoOutput(const MediaMetadata& metadata, int maxWidth, int maxHeight, int referenceBitrate,
+                                  const CameraModelTable& overrides = {});
+
 /**
  * Gets default resolution for a given model
  */
-ResolutionInfo getResolutionForModel(const std::string& model_name);
+ResolutionInfo getResolutionForModel(const std::string& model_name, const CameraModelTable& overrides = {});
+
+/**
+ * Extracts camera model from the EXIF fields (or INSV trailer) of a metadata snapshot
+ */
+std::string extractCameraModel(const MediaMetadata& metadata, const CameraModelTable& overrides = {});
+
+/**
+ * Model name as used for matching: lowercase alphanumerics with the "insta360" brand
+ * removed, e.g. "Insta360 ONE RS" -> "oners"
+ */
+std::string normalizeModelName(const std::string& name);
 
 /**
- * Extracts camera model from EXIF metadata
+ * Loads extra or corrected camera models from a JSON file, to pass to the detection functions:
+ * {"models": [{"name": "Insta360 X5", "aliases": ["x5"], "photoWidth": 11904,
+ *              "photoHeight": 5952, "videoWidth": 7680, "videoHeight": 3840}]}
+ * @return the valid entries, empty (with a warning) if the file cannot be read
  */
-std::string extractCameraModel(const std::string& file_path);
\ No newline at end of file
+CameraModelTable loadCameraModelOverrides(const std::string& path);
@@ -0,0 +1,171 @@
+#include "spherical_metadata.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "file_reader.h"
+
+namespace {
+
+const char* const kMetadataSource = "Insta360 Auto Converter";
+
+Mp4Box makeBox(const char* type, std::vector<uint8_t> payload = {}) {
+    Mp4Box box;
+    box.type = type;
+    box.payload = std::move(payload);
+    return box;
+}
+
+// st3d: stereo mode 0 (monoscopic)
+Mp4Box makeStereoBox() {
+    return makeBox("st3d", {0, 0, 0, 0, 0});
+}
+
+// sv3d { svhd, proj { prhd, equi } }
+Mp4Box makeSphericalBox() {
+    std::vector<uint8_t> svhd = {0, 0, 0, 0};
+    svhd.insert(svhd.end(), kMetadataSource, kMetadataSource + std::strlen(kMetadataSource) + 1);
+
+    Mp4Box proj = makeBox("proj");
+    proj.children.push_back(makeBox("prhd", std::vector<uint8_t>(4 + 12, 0)));  // yaw, pitch, roll = 0
+    proj.children.push_back(makeBox("equi", std::vector<uint8_t>(4 + 16, 0)));  // full-frame bounds
+
+    Mp4Box sv3d = makeBox("sv3d");
+    sv3d.children.push_back(makeBox("svhd", svhd));
+    sv3d.children.push_back(std::move(proj));
+    return sv3d;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+SphericalTagging addSphericalBoxes(Mp4Box& moov) {
+    Mp4Box* trak = findTrack(moov, "vide");
+    Mp4Box* stsd = trak ? trak->find("mdia/minf/stbl/stsd") : nullptr;
+    if (!stsd || stsd->children.empty()) return SphericalTagging::Unsupported;
+
+    // Visual sample entries are parsed with their children (78-byte fields first); an opaque
+    // entry (unknown codec or layout) cannot take the boxes
+    for (const auto& entry : stsd->children) {
+        if (entry.payload.size() != 78) return SphericalTagging::Unsupported;
+    }
+
+    bool changed = false;
+    for (auto& entry : stsd->children) {
+        if (!entry.child("st3d")) {
+            entry.children.push_back(makeStereoBox());
+            changed = true;
+        }
+        if (!entry.child("sv3d")) {
+            entry.children.push_back(makeSphericalBox());
+            changed = true;
+        }
+    }
+    return changed ? SphericalTagging::Tagged : SphericalTagging::AlreadyTagged;
+}
+
+bool injectSphericalMetadata(const std::string& path) {
+    Mp4BoxRef moovRef{};
+    Mp4BoxRef next{};
+    bool hasMoov = false;
+    bool hasNext = false;
+    Mp4BoxRef last{};
+    bool lastToEnd = false;  // The last box has size 0: it extends to the end of the file
+    uint64_t fileSize = 0;
+    Mp4Box moov;
+    {
+        FileReader file(path);
+        if (!file.opened()) {
+            std::cerr << "Error: Cannot read video for spherical metadata: " << path << std::endl;
+            return false;
+        }
+        fileSize = file.size();
+        const auto boxes = scanMp4Boxes(file, 0, fileSize);
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            if (boxes[i].type != "moov") continue;
+            moovRef = boxes[i];
+            std::vector<uint8_t> bytes;
+            hasMoov = file.read(moovRef.offset, static_cast<size_t>(moovRef.size), bytes) &&
+                      parseMp4Box(bytes.data(), moovRef.size, moov);
+            if (i + 1 < boxes.size()) {
+                next = boxes[i + 1];
+                hasNext = true;
+            }
+            break;
+        }
+        if (!boxes.empty()) {
+            last = boxes.back();
+            uint8_t sizeField[4];
+            lastToEnd = file.read(last.offset, sizeField, sizeof(sizeField)) && readBE32(sizeField) == 0;
+        }
+    }
+    if (!hasMoov || !findTrack(moov, "vide")) {
+        std::cerr << "Error: No video track found for spherical metadata: " << path << std::endl;
+        return false;
+    }
+    switch (addSphericalBoxes(moov)) {
+        case SphericalTagging::Tagged:
+            break;
+        case SphericalTagging::AlreadyTagged:
+            return true;
+        case SphericalTagging::Unsupported:
+            std::cerr << "Error: Unsupported video sample entry for spherical metadata: " << path << std::endl;
+            return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    appendMp4Box(bytes, moov);
+    const uint64_t newSize = bytes.size();
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open video for spherical metadata: " << path << std::endl;
+        return false;
+    }
+
+    bool ok;
+    const uint64_t room = moovRef.size + (hasNext && (next.type == "free" || next.type == "skip") ? next.size : 0);
+    if (moovRef.offset + moovRef.size == fileSize) {
+        // moov is the last box: rewrite it and adjust the file length
+        ok = writeAll(fd, bytes.data(), bytes.size(), moovRef.offset) &&
+             ::ftruncate(fd, static_cast<off_t>(moovRef.offset + newSize)) == 0;
+    } else if (newSize == room || newSize + 8 <= room) {
+        // Grow into the following padding; what is left stays a free box
+        if (room > newSize) {
+            appendBE32(bytes, static_cast<uint32_t>(room - newSize));
+            bytes.insert(bytes.end(), {'f', 'r', 'e', 'e'});
+        }
+        ok = writeAll(fd, bytes.data(), bytes.size(), moovRef.offset);
+    } else if (lastToEnd && fileSize - last.offset > 0xFFFFFFFFull) {
+        // An 8-byte header cannot take a 64-bit size in place
+        std::cerr << "Error: Cannot move moov after the open-ended " << last.type << " box of " << path << std::endl;
+        ok = false;
+    } else {
+        // Relocate: append the new moov first, then turn the old one into a free box. A last box
+        // of size 0 (mdat "to the end of the file") would take in the appended moov, so its
+        // size is written out first
+        static const uint8_t kFree[] = {'f', 'r', 'e', 'e'};
+        uint8_t lastSize[4];
+        writeBE32(lastSize, static_cast<uint32_t>(fileSize - last.offset));
+        ok = (!lastToEnd || writeAll(fd, lastSize, sizeof(lastSize), last.offset)) &&
+             writeAll(fd, bytes.data(), bytes.size(), fileSize) &&
+             writeAll(fd, kFree, sizeof(kFree), moovRef.offset + 4);
+    }
+
+    if (::close(fd) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Error: Failed to write spherical metadata to " << path << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,32 @@
+#ifndef SPHERICAL_METADATA_H
+#define SPHERICAL_METADATA_H
+
+#include <string>
+#include "mp4_box.h"
+
+enum class SphericalTagging {
+    Tagged,         // Boxes added to at least one sample entry
+    AlreadyTagged,  // Every sample entry already had them
+    Unsupported,    // No video track, or a sample entry whose layout is not known (left unchanged)
+};
+
+/**
+ * Adds Spherical Video V2 boxes (st3d mono, sv3d with an equirectangular projection) to
+ * every visual sample entry of the video track of a parsed moov. Nothing is changed unless
+ * every entry can be tagged.
+ */
+SphericalTagging addSphericalBoxes(Mp4Box& moov);
+
+/**
+ * Tags an MP4 file as a 360° equirectangular video without rewriting its sample data.
+ *
+ * Only moov is rewritten: in place if it is the last box or fits in a following free box,
+ * otherwise the new moov is appended at the end of the file (after giving a last box of
+ * size 0 an explicit size) and the old one becomes a free box. mdat never moves, so chunk
+ * offsets stay valid. Files already tagged are left as is.
+ * @return false (with a message on stderr) if the file could not be tagged, including video
+ *         sample entries that are not known
+ */
+bool injectSphericalMetadata(const std::string& path);
+
+#endif // SPHERICAL_METADATA_H
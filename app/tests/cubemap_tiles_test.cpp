@@ -0,0 +1,175 @@
+// Cuts a synthetic equirectangular JPEG into cubemap tiles and checks what each face sees
+#include <cmath>
+#include <fstream>
+#include <json/json.h>
+#include "cubemap_tiles.h"
+#include "jpeg_io.h"
+#include "test_support.h"
+
+namespace {
+
+constexpr int kSourceWidth = 1024;
+constexpr int kSourceHeight = 512;
+constexpr int kTileSize = 100;  // Does not divide the face size: the last tiles are smaller
+
+struct Rgb {
+    int r, g, b;
+};
+
+// Above 60° white, below -60° black, otherwise one colour per quadrant of longitude
+// centred on each side face, at half intensity in the southern hemisphere
+constexpr Rgb kUp = {255, 255, 255};
+constexpr Rgb kDown = {0, 0, 0};
+constexpr Rgb kFront = {255, 0, 0};
+constexpr Rgb kRight = {0, 255, 0};
+constexpr Rgb kBack = {0, 0, 255};
+constexpr Rgb kLeft = {255, 255, 0};
+
+constexpr Rgb dim(const Rgb& color) {
+    return {color.r / 2, color.g / 2, color.b / 2};
+}
+
+Rgb sourceColor(int x, int y) {
+    if (y < kSourceHeight / 6) return kUp;
+    if (y >= kSourceHeight * 5 / 6) return kDown;
+    const int octant = x * 8 / kSourceWidth;  // Longitude -180° at x = 0, 0° at the centre
+    Rgb color = kBack;
+    if (octant == 3 || octant == 4) color = kFront;
+    if (octant == 5 || octant == 6) color = kRight;
+    if (octant == 1 || octant == 2) color = kLeft;
+    return y < kSourceHeight / 2 ? color : dim(color);
+}
+
+std::filesystem::path writeSource(const std::filesystem::path& dir) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(kSourceWidth) * kSourceHeight * 3);
+    for (int y = 0; y < kSourceHeight; ++y) {
+        for (int x = 0; x < kSourceWidth; ++x) {
+            const Rgb color = sourceColor(x, y);
+            uint8_t* p = &pixels[(static_cast<size_t>(y) * kSourceWidth + x) * 3];
+            p[0] = static_cast<uint8_t>(color.r);
+            p[1] = static_cast<uint8_t>(color.g);
+            p[2] = static_cast<uint8_t>(color.b);
+        }
+    }
+    const auto path = dir / "pano.jpg";
+    CHECK(writeJpegRgb(path.string(), pixels.data(), kSourceWidth, kSourceHeight, 95));
+    return path;
+}
+
+// Decodes the tile holding pixel (x, y) of a face and checks its colour
+void checkFacePixel(const std::filesystem::path& outDir, int level, const std::string& face, int x, int y,
+                    const Rgb& expected) {
+    const auto path = outDir / std::to_string(level) / face / std::to_string(y / kTileSize) /
+                      (std::to_string(x / kTileSize) + ".jpg");
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    CHECK(readJpegRgb(path.string(), pixels, width, height));
+    if (x % kTileSize >= width || y % kTileSize >= height) {
+        CHECK(false);
+        return;
+    }
+    const uint8_t* p = &pixels[(static_cast<size_t>(y % kTileSize) * width + x % kTileSize) * 3];
+    const bool matches = std::abs(p[0] - expected.r) < 60 && std::abs(p[1] - expected.g) < 60 &&
+                         std::abs(p[2] - expected.b) < 60;
+    if (!matches) {
+        std::cerr << "  face " << face << " level " << level << " at " << x << "," << y << ": got "
+                  << int(p[0]) << "," << int(p[1]) << "," << int(p[2]) << "\n";
+    }
+    CHECK(matches);
+}
+
+void testTiles(const std::filesystem::path& dir) {
+    const auto outDir = dir / "tiles";
+    CubemapTileOptions options;
+    options.tileSize = kTileSize;
+    options.threads = 4;
+    const CubemapTileResult result = generateCubemapTiles(writeSource(dir).string(), outDir.string(), options);
+
+    // A side face spans a quarter of the width: 256px, then halved down to one tile
+    CHECK(result.success);
+    CHECK_EQ(result.directory, outDir.string());
+    CHECK_EQ(result.faceSize, 256);
+    CHECK_EQ(result.levels, 3);
+    CHECK_EQ(result.tileCount, (1 + 4 + 9) * 6);
+
+    Json::Value descriptor;
+    std::ifstream json(outDir / "tiles.json");
+    CHECK(Json::parseFromStream(Json::CharReaderBuilder(), json, &descriptor, nullptr));
+    CHECK_EQ(descriptor["type"].asString(), "cubemap");
+    CHECK_EQ(descriptor["source"].asString(), "pano.jpg");
+    CHECK_EQ(descriptor["tileSize"].asInt(), kTileSize);
+    CHECK_EQ(descriptor["faceSize"].asInt(), 256);
+    CHECK_EQ(descriptor["urlTemplate"].asString(), "{z}/{f}/{y}/{x}.jpg");
+    const char* faces[] = {"f", "r", "b", "l", "u", "d"};
+    CHECK_EQ(descriptor["faces"].size(), 6u);
+    for (Json::ArrayIndex i = 0; i < descriptor["faces"].size() && i < 6; ++i) {
+        CHECK_EQ(descriptor["faces"][i].asString(), faces[i]);
+    }
+    const int sizes[] = {64, 128, 256};
+    CHECK_EQ(descriptor["levels"].size(), 3u);
+    for (Json::ArrayIndex i = 0; i < descriptor["levels"].size() && i < 3; ++i) {
+        CHECK_EQ(descriptor["levels"][i]["size"].asInt(), sizes[i]);
+        CHECK_EQ(descriptor["levels"][i]["tileSize"].asInt(), kTileSize);
+    }
+
+    int files = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(outDir)) {
+        if (entry.path().extension() == ".jpg") ++files;
+    }
+    CHECK_EQ(files, result.tileCount);
+
+    // Edge tiles hold what is left of the face
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    CHECK(readJpegRgb((outDir / "2/f/2/2.jpg").string(), pixels, width, height));
+    CHECK_EQ(width, 56);
+    CHECK_EQ(height, 56);
+
+    // Each side face looks at its own quadrant, upright, on every level
+    for (int level = 0; level < 3; ++level) {
+        const int centre = sizes[level] / 2;
+        const int upper = sizes[level] / 4;
+        const int lower = sizes[level] * 3 / 4;
+        checkFacePixel(outDir, level, "f", centre, upper, kFront);
+        checkFacePixel(outDir, level, "f", centre, lower, dim(kFront));
+        checkFacePixel(outDir, level, "r", centre, upper, kRight);
+        checkFacePixel(outDir, level, "r", centre, lower, dim(kRight));
+        checkFacePixel(outDir, level, "b", centre, upper, kBack);
+        checkFacePixel(outDir, level, "l", centre, upper, kLeft);
+        checkFacePixel(outDir, level, "u", centre, centre, kUp);
+        checkFacePixel(outDir, level, "d", centre, centre, kDown);
+    }
+
+    // Orientation of the poles: u has its bottom edge on f and its right edge on r, d has
+    // its top edge on f; near the edges the faces see below/above 60°
+    const int size = 256;
+    checkFacePixel(outDir, 2, "u", size / 2, size - 10, kFront);
+    checkFacePixel(outDir, 2, "u", size / 2, 10, kBack);
+    checkFacePixel(outDir, 2, "u", size - 10, size / 2, kRight);
+    checkFacePixel(outDir, 2, "u", 10, size / 2, kLeft);
+    checkFacePixel(outDir, 2, "d", size / 2, 10, dim(kFront));
+    checkFacePixel(outDir, 2, "d", size / 2, size - 10, dim(kBack));
+    checkFacePixel(outDir, 2, "d", size - 10, size / 2, dim(kRight));
+}
+
+void testUnreadableSource(const std::filesystem::path& dir) {
+    const auto path = dir / "broken.jpg";
+    writeFileBytes(path, {'n', 'o', 't', ' ', 'a', ' ', 'j', 'p', 'e', 'g'});
+    const auto outDir = dir / "broken_tiles";
+    const CubemapTileResult result = generateCubemapTiles(path.string(), outDir.string(), CubemapTileOptions());
+    CHECK(!result.success);
+    CHECK_EQ(result.tileCount, 0);
+    CHECK(!std::filesystem::exists(outDir / "tiles.json"));
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("cubemap_tiles_test");
+    testTiles(dir);
+    testUnreadableSource(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
@@ -0,0 +1,267 @@
+// Serializes EXIF/XMP segments, splices them into synthetic JPEG headers and parses them back
+#include <cmath>
+#include <string>
+#include <utility>
+#include "exif_metadata.h"
+#include "jpeg_metadata.h"
+#include "media_metadata.h"
+#include "test_support.h"
+
+namespace {
+
+const std::vector<uint8_t> kScanData = {0x12, 0x34, 0xFF, 0x00, 0x56, 0xFF, 0xD9};  // Entropy-coded data + EOI
+
+ExifEntry rationalEntry(ExifIfd ifd, uint16_t tag, const std::vector<std::pair<uint32_t, uint32_t>>& values) {
+    ExifEntry entry{ifd, tag, kExifRational, static_cast<uint32_t>(values.size()), {}};
+    for (const auto& [numerator, denominator] : values) {
+        for (uint32_t value : {numerator, denominator}) {
+            for (int i = 0; i < 4; ++i) entry.data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    return entry;
+}
+
+const ExifEntry* findEntry(const std::vector<ExifEntry>& entries, ExifIfd ifd, uint16_t tag) {
+    for (const auto& entry : entries) {
+        if (entry.ifd == ifd && entry.tag == tag) return &entry;
+    }
+    return nullptr;
+}
+
+std::string asciiOf(const std::vector<ExifEntry>& entries, ExifIfd ifd, uint16_t tag) {
+    const ExifEntry* entry = findEntry(entries, ifd, tag);
+    return entry && !entry->data.empty() ? std::string(entry->data.begin(), entry->data.end() - 1) : "";
+}
+
+JpegSegment xmpSegment(const std::string& packet) {
+    const char ns[] = "http://ns.adobe.com/xap/1.0/";
+    JpegSegment segment{0xE1, std::vector<uint8_t>(ns, ns + sizeof(ns))};
+    segment.payload.insert(segment.payload.end(), packet.begin(), packet.end());
+    return segment;
+}
+
+// SOI, the given segments, a 100x50 SOF0, SOS and kScanData
+std::vector<uint8_t> buildJpeg(const std::vector<JpegSegment>& segments) {
+    std::vector<JpegSegment> all = segments;
+    all.push_back({0xC0, {8, 0, 50, 0, 100, 1, 1, 0x11, 0}});
+    all.push_back({0xDA, {1, 1, 0, 0, 63, 0}});
+    std::vector<uint8_t> file = {0xFF, 0xD8};
+    for (const auto& segment : all) {
+        const size_t length = segment.payload.size() + 2;
+        file.insert(file.end(), {0xFF, segment.marker, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)});
+        file.insert(file.end(), segment.payload.begin(), segment.payload.end());
+    }
+    file.insert(file.end(), kScanData.begin(), kScanData.end());
+    return file;
+}
+
+// Marker segments of a JPEG up to and including SOS
+std::vector<JpegSegment> readSegments(const std::vector<uint8_t>& file) {
+    std::vector<JpegSegment> segments;
+    size_t pos = 2;
+    while (pos + 4 <= file.size() && file[pos] == 0xFF) {
+        const size_t length = (static_cast<size_t>(file[pos + 2]) << 8) | file[pos + 3];
+        if (pos + 2 + length > file.size()) break;
+        segments.push_back({file[pos + 1], std::vector<uint8_t>(file.begin() + pos + 4, file.begin() + pos + 2 + length)});
+        pos += 2 + length;
+        if (segments.back().marker == 0xDA) break;
+    }
+    return segments;
+}
+
+bool isXmp(const JpegSegment& segment) {
+    const std::string prefix = "http://ns.adobe.com/xap/1.0/";
+    return segment.marker == 0xE1 && std::string(segment.payload.begin(), segment.payload.end()).compare(0, prefix.size(), prefix) == 0;
+}
+
+size_t countOf(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) ++count;
+    return count;
+}
+
+void testExifRoundTrip() {
+    const std::vector<ExifEntry> written = {
+        makeAsciiEntry(ExifIfd::Image, 0x010F, "Stitcher"),
+        makeAsciiEntry(ExifIfd::Image, 0x0110, "Insta360 X4"),
+        makeShortEntry(ExifIfd::Image, 0x0112, 1),
+        rationalEntry(ExifIfd::Photo, 0x829A, {{1, 100}}),
+        makeShortEntry(ExifIfd::Photo, 0x8827, 200),
+        makeAsciiEntry(ExifIfd::GPS, 0x0001, "N"),
+        rationalEntry(ExifIfd::GPS, 0x0002, {{48, 1}, {51, 1}, {30, 1}}),
+        makeAsciiEntry(ExifIfd::Image, 0x010F, "Insta360"),  // Overrides the first Make
+    };
+    const JpegSegment segment = buildExifSegment(written);
+    CHECK_EQ(segment.marker, 0xE1);
+
+    std::vector<ExifEntry> parsed;
+    CHECK(parseExifSegment(segment.payload.data(), segment.payload.size(), parsed));
+    CHECK_EQ(parsed.size(), written.size() - 1);
+    for (size_t i = 1; i < written.size(); ++i) {
+        const ExifEntry& expected = written[i];
+        const ExifEntry* entry = findEntry(parsed, expected.ifd, expected.tag);
+        CHECK(entry != nullptr);
+        if (!entry) continue;
+        CHECK_EQ(entry->type, expected.type);
+        CHECK_EQ(entry->count, expected.count);
+        CHECK(entry->data == expected.data);
+    }
+    CHECK_EQ(asciiOf(parsed, ExifIfd::Image, 0x010F), "Insta360");
+
+    const uint8_t notExif[] = {'J', 'F', 'I', 'F', 0, 1};
+    CHECK(!parseExifSegment(notExif, sizeof(notExif), parsed));
+}
+
+void testBigEndianExif() {
+    // MM TIFF: IFD0 { Make "Cam", ExifIFD -> { ISOSpeedRatings 400, ExposureTime 1/250 } }
+    const std::vector<uint8_t> payload = {
+        'E', 'x', 'i', 'f', 0, 0,
+        'M', 'M', 0, 42, 0, 0, 0, 8,
+        0, 2,                                       // IFD0 at 8: 2 entries
+        0x01, 0x0F, 0, 2, 0, 0, 0, 4, 'C', 'a', 'm', 0,
+        0x87, 0x69, 0, 4, 0, 0, 0, 1, 0, 0, 0, 38,
+        0, 0, 0, 0,
+        0, 2,                                       // Exif IFD at 38: 2 entries
+        0x88, 0x27, 0, 3, 0, 0, 0, 1, 0x01, 0x90, 0, 0,
+        0x82, 0x9A, 0, 5, 0, 0, 0, 1, 0, 0, 0, 68,
+        0, 0, 0, 0,
+        0, 0, 0, 1, 0, 0, 0, 250,                   // Rational at 68
+    };
+    std::vector<ExifEntry> parsed;
+    CHECK(parseExifSegment(payload.data(), payload.size(), parsed));
+    CHECK_EQ(parsed.size(), 3u);
+    CHECK_EQ(asciiOf(parsed, ExifIfd::Image, 0x010F), "Cam");
+    const ExifEntry* iso = findEntry(parsed, ExifIfd::Photo, 0x8827);
+    CHECK(iso != nullptr && iso->data == std::vector<uint8_t>({0x90, 0x01}));
+    const ExifEntry* exposure = findEntry(parsed, ExifIfd::Photo, 0x829A);
+    CHECK(exposure != nullptr && exposure->data == rationalEntry(ExifIfd::Photo, 0x829A, {{1, 250}}).data);
+}
+
+void testSpliceMergesExistingMetadata(const std::filesystem::path& dir) {
+    const auto path = dir / "stitched.jpg";
+    const JpegSegment jfif{0xE0, {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0}};
+    const JpegSegment dqt{0xDB, std::vector<uint8_t>(65, 1)};
+    writeFileBytes(path, buildJpeg({
+        jfif,
+        buildExifSegment({makeAsciiEntry(ExifIfd::Image, 0x010F, "Stitcher"),
+                          makeAsciiEntry(ExifIfd::Image, 0x0131, "Stitcher 1.0"),
+                          makeAsciiEntry(ExifIfd::Photo, 0x9003, "2024:05:01 10:00:00")}),
+        xmpSegment("<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"><rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+                   "<rdf:Description rdf:about=\"\" xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\" xmp:CreatorTool=\"Stitcher\"/>"
+                   "</rdf:RDF></x:xmpmeta>"),
+        dqt,
+    }));
+
+    const std::vector<JpegSegment> updates = {
+        buildExifSegment({makeAsciiEntry(ExifIfd::Image, 0x0131, "Insta360 Auto Converter"),
+                          makeAsciiEntry(ExifIfd::Image, 0x010E, "360 degree panorama")}),
+        buildPanoramaXmpSegment(100, 50),
+    };
+    CHECK(spliceJpegMetadata(path.string(), updates));
+    CHECK(!std::filesystem::exists(path.string() + ".meta.tmp"));
+
+    const auto file = readFileBytes(path);
+    const auto segments = readSegments(file);
+    CHECK_EQ(segments.size(), 6u);
+    if (segments.size() != 6) return;
+
+    // JFIF stays first, the merged metadata follows, then the rest of the header as it was
+    CHECK_EQ(segments[0].marker, 0xE0);
+    CHECK(segments[3].marker == dqt.marker && segments[3].payload == dqt.payload);
+    CHECK_EQ(segments[4].marker, 0xC0);
+    CHECK_EQ(segments[5].marker, 0xDA);
+    CHECK(std::equal(kScanData.rbegin(), kScanData.rend(), file.rbegin()));
+
+    std::vector<ExifEntry> exif;
+    CHECK(parseExifSegment(segments[1].payload.data(), segments[1].payload.size(), exif));
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x010F), "Stitcher");
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x0131), "Insta360 Auto Converter");
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x010E), "360 degree panorama");
+    CHECK_EQ(asciiOf(exif, ExifIfd::Photo, 0x9003), "2024:05:01 10:00:00");
+
+    CHECK(isXmp(segments[2]));
+    const std::string xmp(segments[2].payload.begin(), segments[2].payload.end());
+    CHECK_EQ(countOf(xmp, "xmp:CreatorTool=\"Stitcher\""), 1u);
+    CHECK_EQ(countOf(xmp, "GPano:FullPanoWidthPixels=\"100\""), 1u);
+    CHECK_EQ(countOf(xmp, "GPano:CroppedAreaImageHeightPixels=\"50\""), 1u);
+    CHECK_EQ(countOf(xmp, "</rdf:RDF>"), 1u);
+
+    // Converting again replaces the earlier GPano description instead of adding a second one,
+    // and keeps the EXIF segment that this update does not touch
+    CHECK(spliceJpegMetadata(path.string(), {buildPanoramaXmpSegment(200, 100)}));
+    const auto again = readSegments(readFileBytes(path));
+    CHECK_EQ(again.size(), 6u);
+    if (again.size() != 6) return;
+    CHECK(again[1].payload == segments[1].payload || again[2].payload == segments[1].payload);
+    const std::string replaced(again[1].payload.begin(), again[1].payload.end());
+    CHECK(isXmp(again[1]));
+    CHECK_EQ(countOf(replaced, "xmlns:GPano="), 1u);
+    CHECK_EQ(countOf(replaced, "GPano:FullPanoWidthPixels=\"200\""), 1u);
+    CHECK_EQ(countOf(replaced, "xmp:CreatorTool=\"Stitcher\""), 1u);
+}
+
+void testSpliceRejectsMalformedFiles(const std::filesystem::path& dir) {
+    const auto path = dir / "broken.jpg";
+    std::vector<uint8_t> file = buildJpeg({});
+    file.resize(8);  // Cut inside the SOF0 segment
+    writeFileBytes(path, file);
+    CHECK(!spliceJpegMetadata(path.string(), {buildPanoramaXmpSegment(100, 50)}));
+    CHECK(readFileBytes(path) == file);
+    CHECK(!std::filesystem::exists(path.string() + ".meta.tmp"));
+}
+
+// The original's snapshot keeps only the 21 preserved tags; the 360 segments add the overrides
+void testPreservedTagsReachTheConvertedFile(const std::filesystem::path& dir) {
+    const auto path = dir / "IMG_1.insp";
+    writeFileBytes(path, buildJpeg({buildExifSegment({
+        makeAsciiEntry(ExifIfd::Image, 0x010F, "Arashi Vision"),
+        makeAsciiEntry(ExifIfd::Image, 0x0110, "Insta360 X4"),
+        makeAsciiEntry(ExifIfd::Image, 0x0131, "X4 firmware"),
+        makeAsciiEntry(ExifIfd::Photo, 0x9003, "2024:05:01 10:00:00"),
+        makeAsciiEntry(ExifIfd::Photo, 0x9286, "not preserved"),  // UserComment
+        makeShortEntry(ExifIfd::Photo, 0xA002, 11904),
+        makeShortEntry(ExifIfd::Photo, 0xA003, 5952),
+        makeAsciiEntry(ExifIfd::GPS, 0x0001, "N"),
+        rationalEntry(ExifIfd::GPS, 0x0002, {{48, 1}, {51, 1}, {30, 1}}),
+        makeAsciiEntry(ExifIfd::GPS, 0x0003, "W"),
+        rationalEntry(ExifIfd::GPS, 0x0004, {{2, 1}, {17, 1}, {40, 1}}),
+    })}));
+
+    const MediaMetadata meta = readMediaMetadata(path.string());
+    CHECK(meta.valid);
+    CHECK_EQ(meta.model, "Insta360 X4");
+    CHECK_EQ(meta.captureTime, "2024:05:01 10:00:00");
+    CHECK_EQ(meta.width, 11904);
+    CHECK_EQ(meta.height, 5952);
+    CHECK(meta.hasGps && std::fabs(meta.latitude - 48.858333) < 1e-5 && std::fabs(meta.longitude + 2.294444) < 1e-5);
+    CHECK_EQ(meta.preservedEntries.size(), 8u);
+    CHECK(findEntry(meta.preservedEntries, ExifIfd::Photo, 0x9286) == nullptr);
+
+    const auto segments = build360MetadataSegments(meta, 11904, 5952);
+    CHECK_EQ(segments.size(), 2u);
+    if (segments.size() != 2) return;
+    std::vector<ExifEntry> exif;
+    CHECK(parseExifSegment(segments[0].payload.data(), segments[0].payload.size(), exif));
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x010F), "Arashi Vision");
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x0110), "Insta360 X4");
+    CHECK_EQ(asciiOf(exif, ExifIfd::Image, 0x0131), "Insta360 Auto Converter");
+    CHECK_EQ(asciiOf(exif, ExifIfd::GPS, 0x0003), "W");
+    CHECK(findEntry(exif, ExifIfd::Photo, 0x9286) == nullptr);
+    const ExifEntry* orientation = findEntry(exif, ExifIfd::Image, 0x0112);
+    CHECK(orientation != nullptr && orientation->data == std::vector<uint8_t>({1, 0}));
+    const std::string xmp(segments[1].payload.begin(), segments[1].payload.end());
+    CHECK_EQ(countOf(xmp, "GPano:FullPanoWidthPixels=\"11904\""), 1u);
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("jpeg_metadata_test");
+    testExifRoundTrip();
+    testBigEndianExif();
+    testSpliceMergesExistingMetadata(dir);
+    testSpliceRejectsMalformedFiles(dir);
+    testPreservedTagsReachTheConvertedFile(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
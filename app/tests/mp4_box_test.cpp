@@ -0,0 +1,140 @@
+// Lists and parses MP4 boxes, and reads the metadata snapshot of a synthetic video
+#include <algorithm>
+#include "file_reader.h"
+#include "media_metadata.h"
+#include "mp4_fixture.h"
+
+namespace {
+
+std::vector<FixtureTrack> videoTrack() {
+    FixtureTrack video;
+    video.sampleCount = 90;         // 3 s at 30 fps
+    video.syncSamples = {1, 31, 61};
+    return {video};
+}
+
+void testScanTopLevelBoxes() {
+    // free (32-bit size), mdat with a 64-bit size, then a box running to the end of the buffer
+    std::vector<uint8_t> bytes;
+    appendMp4Box(bytes, fixtureBox("free", {1, 2, 3, 4}));
+    appendBE32(bytes, 1);
+    bytes.insert(bytes.end(), {'m', 'd', 'a', 't'});
+    appendBE64(bytes, 16 + 8);
+    appendBE64(bytes, 0x0102030405060708ull);
+    appendBE32(bytes, 0);
+    bytes.insert(bytes.end(), {'m', 'o', 'o', 'v', 9, 9, 9});
+
+    const auto boxes = scanMp4Boxes(bytes.data(), 0, bytes.size());
+    CHECK_EQ(boxes.size(), 3u);
+    if (boxes.size() != 3) return;
+    CHECK_EQ(boxes[0].type, "free");
+    CHECK_EQ(boxes[0].size, 12u);
+    CHECK_EQ(boxes[1].type, "mdat");
+    CHECK_EQ(boxes[1].offset, 12u);
+    CHECK_EQ(boxes[1].size, 24u);
+    CHECK_EQ(boxes[1].headerSize, 16u);
+    CHECK_EQ(boxes[2].type, "moov");
+    CHECK_EQ(boxes[2].size, 11u);  // Size 0: up to the end
+
+    // A box claiming more than what is left ends the list
+    std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + 30);
+    CHECK_EQ(scanMp4Boxes(truncated.data(), 0, truncated.size()).size(), 1u);
+}
+
+void testScanFileMatchesBuffer(const std::filesystem::path& dir) {
+    const auto path = dir / "scan.mp4";
+    const auto bytes = buildFixtureMp4(videoTrack());
+    writeFileBytes(path, bytes);
+
+    FileReader file(path.string());
+    CHECK(file.opened());
+    CHECK_EQ(file.size(), bytes.size());
+    const auto fromFile = scanMp4Boxes(file, 0, file.size());
+    const auto fromBuffer = scanMp4Boxes(bytes.data(), 0, bytes.size());
+    CHECK_EQ(fromFile.size(), 3u);
+    CHECK_EQ(fromFile.size(), fromBuffer.size());
+    for (size_t i = 0; i < fromFile.size() && i < fromBuffer.size(); ++i) {
+        CHECK_EQ(fromFile[i].type, fromBuffer[i].type);
+        CHECK_EQ(fromFile[i].offset, fromBuffer[i].offset);
+        CHECK_EQ(fromFile[i].size, fromBuffer[i].size);
+    }
+    CHECK(!file.failed());
+}
+
+void testParseSerializeRoundTrip() {
+    const auto file = buildFixtureMp4(videoTrack());
+    Mp4Box moov;
+    CHECK(readFixtureMoov(file, moov));
+
+    // Containers and sample entries are parsed into children, leaves keep their bytes
+    const Mp4Box* avc1 = moov.find("trak/mdia/minf/stbl/stsd/avc1");
+    CHECK(avc1 != nullptr);
+    if (avc1) {
+        CHECK_EQ(avc1->payload.size(), 78u);
+        CHECK(avc1->child("avcC") != nullptr);
+    }
+    CHECK(findTrack(moov, "vide") != nullptr);
+    CHECK(findTrack(moov, "soun") == nullptr);
+
+    std::vector<uint8_t> serialized;
+    appendMp4Box(serialized, moov);
+    CHECK_EQ(serialized.size(), moov.size());
+    const auto boxes = scanMp4Boxes(file.data(), 0, file.size());
+    CHECK(boxes.back().type == "moov" &&
+          std::equal(serialized.begin(), serialized.end(), file.begin() + boxes.back().offset));
+
+    // Growing a leaf fixes the size of every parent
+    Mp4Box grown = moov;
+    grown.find("trak/mdia/minf/stbl/stsd/avc1/avcC")->payload.resize(105);
+    CHECK_EQ(grown.size(), moov.size() + 100);
+    std::vector<uint8_t> grownBytes;
+    appendMp4Box(grownBytes, grown);
+    Mp4Box reparsed;
+    CHECK(parseMp4Box(grownBytes.data(), grownBytes.size(), reparsed));
+    const Mp4Box* avcC = reparsed.find("trak/mdia/minf/stbl/stsd/avc1/avcC");
+    CHECK(avcC != nullptr && avcC->payload.size() == 105);
+}
+
+void testVideoSnapshot(const std::filesystem::path& dir) {
+    const auto path = dir / "clip.mp4";
+    writeFileBytes(path, buildFixtureMp4(videoTrack(), 1000, true));
+
+    const MediaMetadata meta = readMediaMetadata(path.string());
+    CHECK(meta.valid);
+    CHECK_EQ(meta.fileSize, std::filesystem::file_size(path));
+    CHECK_EQ(meta.width, 1920);
+    CHECK_EQ(meta.height, 960);
+    CHECK_EQ(meta.durationSeconds, 3.0);
+    CHECK_EQ(meta.frameRate, 30.0);
+    CHECK(meta.syncSampleMs == std::vector<int64_t>({0, 1000, 2000}));
+}
+
+void testShortReadFails(const std::filesystem::path& dir) {
+    const auto path = dir / "copying.mp4";
+    writeFileBytes(path, buildFixtureMp4(videoTrack()));
+
+    // The file shrinks after it was opened, as when a copy to the watch folder restarts
+    FileReader file(path.string());
+    const uint64_t size = file.size();
+    std::filesystem::resize_file(path, size / 2);
+
+    uint8_t head[8];
+    CHECK(file.read(0, head, sizeof(head)));
+    CHECK(!file.failed());
+    std::vector<uint8_t> tail;
+    CHECK(!file.read(size - 16, 16, tail));
+    CHECK(file.failed());
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("mp4_box_test");
+    testScanTopLevelBoxes();
+    testScanFileMatchesBuffer(dir);
+    testParseSerializeRoundTrip();
+    testVideoSnapshot(dir);
+    testShortReadFails(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
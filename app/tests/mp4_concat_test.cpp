@@ -0,0 +1,158 @@
+// Joins synthetic segments and checks the merged sample tables, edit lists and durations
+#include "mp4_concat.h"
+#include "mp4_fixture.h"
+
+namespace {
+
+// Video: 1 s at 30 fps with a 2-frame B-frame delay. Audio: 48 kHz AAC, 1024 priming samples.
+std::vector<FixtureTrack> segmentTracks(uint8_t tag) {
+    FixtureTrack video;
+    video.syncSamples = {1, 16};
+    video.editMediaTime = 6000;
+    video.editDuration = 1000;
+    video.tag = tag;
+
+    FixtureTrack audio;
+    audio.handler = "soun";
+    audio.timescale = 48000;
+    audio.sampleDelta = 1024;
+    audio.sampleCount = 48;
+    audio.editMediaTime = 1024;
+    audio.editDuration = 1002;  // (48 * 1024 - 1024) / 48 ms
+    audio.tag = tag;
+    return {video, audio};
+}
+
+struct EditEntry {
+    uint64_t duration;
+    int64_t mediaTime;
+};
+
+std::vector<EditEntry> editList(const Mp4Box& trak) {
+    std::vector<EditEntry> entries;
+    const Mp4Box* elst = trak.find("edts/elst");
+    if (!elst) return entries;
+    const bool v1 = elst->payload[0] == 1;
+    const size_t entrySize = v1 ? 20 : 12;
+    for (uint32_t i = 0; i < readBE32(elst->payload.data() + 4); ++i) {
+        const uint8_t* e = elst->payload.data() + 8 + entrySize * i;
+        entries.push_back({v1 ? readBE64(e) : readBE32(e),
+                           v1 ? static_cast<int64_t>(readBE64(e + 8)) : static_cast<int32_t>(readBE32(e + 4))});
+    }
+    return entries;
+}
+
+uint32_t tableValue(const Mp4Box& trak, const char* table, size_t offset) {
+    const Mp4Box* box = trak.find(std::string("mdia/minf/stbl/") + table);
+    return box && box->payload.size() >= offset + 4 ? readBE32(box->payload.data() + offset) : 0;
+}
+
+void testJoinTwoSegments(const std::filesystem::path& dir) {
+    const auto first = dir / "s0.mp4";
+    const auto second = dir / "s1.mp4";
+    const auto joined = dir / "joined.mp4";
+    writeFileBytes(first, buildFixtureMp4(segmentTracks('A')));
+    writeFileBytes(second, buildFixtureMp4(segmentTracks('B')));
+
+    CHECK(concatenateMp4({first.string(), second.string()}, joined.string()));
+    const auto file = readFileBytes(joined);
+    Mp4Box moov;
+    CHECK(readFixtureMoov(file, moov));
+
+    const Mp4Box* mvhd = moov.child("mvhd");
+    const Mp4Box* video = findTrack(moov, "vide");
+    const Mp4Box* audio = findTrack(moov, "soun");
+    CHECK(mvhd && video && audio);
+    if (!mvhd || !video || !audio) return;
+
+    // Movie and track durations, in the movie timescale (ms)
+    CHECK_EQ(readBE32(mvhd->payload.data() + 16), 2004u);
+    CHECK_EQ(readBE32(video->child("tkhd")->payload.data() + 20), 2000u);
+    CHECK_EQ(readBE32(audio->child("tkhd")->payload.data() + 20), 2004u);
+
+    // Media durations, in the media timescales
+    CHECK_EQ(readBE32(video->find("mdia/mdhd")->payload.data() + 16), 180000u);
+    CHECK_EQ(readBE32(audio->find("mdia/mdhd")->payload.data() + 16), 98304u);
+
+    // The video delay is the same shift throughout: one edit for the whole track
+    const auto videoEdits = editList(*video);
+    CHECK_EQ(videoEdits.size(), 1u);
+    if (videoEdits.size() == 1) {
+        CHECK_EQ(videoEdits[0].duration, 2000u);
+        CHECK_EQ(videoEdits[0].mediaTime, 6000);
+    }
+
+    // Each segment's audio priming stays cut: one edit per segment
+    const auto audioEdits = editList(*audio);
+    CHECK_EQ(audioEdits.size(), 2u);
+    if (audioEdits.size() == 2) {
+        CHECK_EQ(audioEdits[0].duration, 1002u);
+        CHECK_EQ(audioEdits[0].mediaTime, 1024);
+        CHECK_EQ(audioEdits[1].duration, 1002u);
+        CHECK_EQ(audioEdits[1].mediaTime, 49152 + 1024);
+    }
+
+    // Sample tables: one stts run, sync samples renumbered, every sample kept
+    CHECK_EQ(tableValue(*video, "stts", 4), 1u);
+    CHECK_EQ(tableValue(*video, "stts", 8), 60u);
+    CHECK_EQ(tableValue(*video, "stts", 12), 3000u);
+    CHECK_EQ(tableValue(*video, "stss", 4), 4u);
+    CHECK_EQ(tableValue(*video, "stss", 16), 31u);
+    CHECK_EQ(tableValue(*video, "stss", 20), 46u);
+    CHECK_EQ(tableValue(*video, "stsz", 8), 60u);
+    CHECK_EQ(tableValue(*audio, "stsz", 8), 96u);
+
+    // Chunk offsets point at the samples of the right segment
+    CHECK_EQ(tableValue(*video, "stco", 4), 2u);
+    const uint32_t secondVideoChunk = tableValue(*video, "stco", 12);
+    CHECK(secondVideoChunk + 4 <= file.size());
+    if (secondVideoChunk + 4 <= file.size()) {
+        CHECK_EQ(readBE32(file.data() + secondVideoChunk), fixtureSample(segmentTracks('B')[0], 0, 0));
+    }
+    const uint32_t firstAudioChunk = tableValue(*audio, "stco", 8);
+    CHECK(firstAudioChunk + 4 <= file.size());
+    if (firstAudioChunk + 4 <= file.size()) {
+        CHECK_EQ(readBE32(file.data() + firstAudioChunk), fixtureSample(segmentTracks('A')[1], 1, 0));
+    }
+}
+
+void testSegmentsWithoutEditList(const std::filesystem::path& dir) {
+    auto tracks = segmentTracks('A');
+    for (auto& track : tracks) track.editMediaTime = -1;
+    const auto first = dir / "plain0.mp4";
+    const auto second = dir / "plain1.mp4";
+    const auto joined = dir / "plain.mp4";
+    writeFileBytes(first, buildFixtureMp4(tracks));
+    writeFileBytes(second, buildFixtureMp4(tracks));
+
+    CHECK(concatenateMp4({first.string(), second.string()}, joined.string()));
+    Mp4Box moov;
+    CHECK(readFixtureMoov(readFileBytes(joined), moov));
+    const Mp4Box* video = findTrack(moov, "vide");
+    const Mp4Box* audio = findTrack(moov, "soun");
+    CHECK(video && audio);
+    if (!video || !audio) return;
+    CHECK(!video->find("edts"));
+    CHECK(!audio->find("edts"));
+    CHECK_EQ(readBE32(moov.child("mvhd")->payload.data() + 16), 2048u);
+    CHECK_EQ(readBE32(video->child("tkhd")->payload.data() + 20), 2000u);
+}
+
+void testMismatchedTracksAreRejected(const std::filesystem::path& dir) {
+    const auto first = dir / "two.mp4";
+    const auto second = dir / "one.mp4";
+    writeFileBytes(first, buildFixtureMp4(segmentTracks('A')));
+    writeFileBytes(second, buildFixtureMp4({segmentTracks('B')[0]}));
+    CHECK(!concatenateMp4({first.string(), second.string()}, (dir / "bad.mp4").string()));
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("mp4_concat_test");
+    testJoinTwoSegments(dir);
+    testSegmentsWithoutEditList(dir);
+    testMismatchedTracksAreRejected(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
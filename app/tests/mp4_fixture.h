@@ -0,0 +1,186 @@
+#ifndef MP4_FIXTURE_H
+#define MP4_FIXTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mp4_box.h"
+#include "test_support.h"
+
+// One track of a synthetic MP4 file: constant sample duration, 4-byte samples, one chunk
+struct FixtureTrack {
+    std::string handler = "vide";     // "vide" or "soun"
+    uint32_t timescale = 90000;
+    uint32_t sampleDelta = 3000;
+    uint32_t sampleCount = 30;
+    std::vector<uint32_t> syncSamples; // 1-based; empty = no stss (every sample is a sync sample)
+    int64_t editMediaTime = -1;        // -1 = no edit list
+    uint64_t editDuration = 0;         // Movie timescale
+    uint8_t tag = 'A';                 // First byte of every sample, to tell segments apart
+};
+
+inline Mp4Box fixtureBox(const char* type, std::vector<uint8_t> payload = {}) {
+    Mp4Box box;
+    box.type = type;
+    box.payload = std::move(payload);
+    return box;
+}
+
+inline Mp4Box fixtureTable(const char* type, uint32_t entryCount) {
+    Mp4Box box = fixtureBox(type, {0, 0, 0, 0});
+    appendBE32(box.payload, entryCount);
+    return box;
+}
+
+// Sample i of a track: tag, track index, 16-bit sample index
+inline uint32_t fixtureSample(const FixtureTrack& track, size_t trackIndex, uint32_t i) {
+    return (static_cast<uint32_t>(track.tag) << 24) | (static_cast<uint32_t>(trackIndex) << 16) | (i & 0xFFFF);
+}
+
+/**
+ * Serializes a minimal non-fragmented MP4 (ftyp, mdat, moov) with the given tracks: the
+ * boxes the pipeline reads (mvhd, tkhd, edts, mdhd, hdlr, stsd, stts, stss, stsz, stsc, stco)
+ * with plausible values. Visual sample entries are 1920x960 avc1 with an avcC child.
+ */
+inline std::vector<uint8_t> buildFixtureMp4(const std::vector<FixtureTrack>& tracks, uint32_t movieTimescale = 1000,
+                                            bool moovFirst = false) {
+    std::vector<uint8_t> ftyp;
+    appendMp4Box(ftyp, fixtureBox("ftyp", {'i', 's', 'o', 'm', 0, 0, 2, 0, 'i', 's', 'o', 'm', 'a', 'v', 'c', '1'}));
+
+    std::vector<uint8_t> data;
+    std::vector<uint64_t> chunkOffsets;  // Relative to the mdat payload
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        chunkOffsets.push_back(data.size());
+        for (uint32_t i = 0; i < tracks[t].sampleCount; ++i) appendBE32(data, fixtureSample(tracks[t], t, i));
+    }
+
+    Mp4Box moov = fixtureBox("moov");
+    uint64_t movieDuration = 0;
+    std::vector<uint8_t> mvhd(100, 0);
+    writeBE32(mvhd.data() + 12, movieTimescale);
+    writeBE32(mvhd.data() + 20, 0x00010000);  // Rate
+    writeBE32(mvhd.data() + 96, static_cast<uint32_t>(tracks.size() + 1));
+    moov.children.push_back(fixtureBox("mvhd", mvhd));
+
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        const FixtureTrack& track = tracks[t];
+        const bool video = track.handler == "vide";
+        const uint64_t mediaDuration = static_cast<uint64_t>(track.sampleCount) * track.sampleDelta;
+        const uint64_t trackDuration = track.editMediaTime >= 0 ? track.editDuration
+                                                                : mediaDuration * movieTimescale / track.timescale;
+        movieDuration = std::max(movieDuration, trackDuration);
+
+        Mp4Box trak = fixtureBox("trak");
+        std::vector<uint8_t> tkhd(84, 0);
+        tkhd[3] = 3;  // Enabled, in movie
+        writeBE32(tkhd.data() + 12, static_cast<uint32_t>(t + 1));
+        writeBE32(tkhd.data() + 20, static_cast<uint32_t>(trackDuration));
+        if (video) {
+            writeBE32(tkhd.data() + 76, 1920u << 16);
+            writeBE32(tkhd.data() + 80, 960u << 16);
+        }
+        trak.children.push_back(fixtureBox("tkhd", tkhd));
+
+        if (track.editMediaTime >= 0) {
+            Mp4Box elst = fixtureTable("elst", 1);
+            appendBE32(elst.payload, static_cast<uint32_t>(track.editDuration));
+            appendBE32(elst.payload, static_cast<uint32_t>(track.editMediaTime));
+            appendBE32(elst.payload, 0x00010000);
+            Mp4Box edts = fixtureBox("edts");
+            edts.children.push_back(std::move(elst));
+            trak.children.push_back(std::move(edts));
+        }
+
+        std::vector<uint8_t> mdhd(24, 0);
+        writeBE32(mdhd.data() + 12, track.timescale);
+        writeBE32(mdhd.data() + 16, static_cast<uint32_t>(mediaDuration));
+        std::vector<uint8_t> hdlr(25, 0);
+        std::copy(track.handler.begin(), track.handler.end(), hdlr.begin() + 8);
+
+        Mp4Box entry;
+        if (video) {
+            std::vector<uint8_t> fields(78, 0);
+            fields[7] = 1;  // Data reference index
+            fields[24] = 1920 >> 8;
+            fields[25] = 1920 & 0xFF;
+            fields[26] = 960 >> 8;
+            fields[27] = 960 & 0xFF;
+            entry = fixtureBox("avc1", fields);
+            entry.children.push_back(fixtureBox("avcC", {1, 0x64, 0, 0x28, 0xFF}));
+        } else {
+            std::vector<uint8_t> fields(28, 0);
+            fields[7] = 1;
+            entry = fixtureBox("mp4a", fields);
+        }
+        Mp4Box stsd = fixtureTable("stsd", 1);
+        stsd.children.push_back(std::move(entry));
+
+        Mp4Box stts = fixtureTable("stts", 1);
+        appendBE32(stts.payload, track.sampleCount);
+        appendBE32(stts.payload, track.sampleDelta);
+        Mp4Box stsz = fixtureBox("stsz", {0, 0, 0, 0});
+        appendBE32(stsz.payload, 4);
+        appendBE32(stsz.payload, track.sampleCount);
+        Mp4Box stsc = fixtureTable("stsc", 1);
+        appendBE32(stsc.payload, 1);
+        appendBE32(stsc.payload, track.sampleCount);
+        appendBE32(stsc.payload, 1);
+        Mp4Box stco = fixtureTable("stco", 1);
+        appendBE32(stco.payload, 0);  // Patched once the layout is known
+
+        Mp4Box stbl = fixtureBox("stbl");
+        stbl.children.push_back(std::move(stsd));
+        stbl.children.push_back(std::move(stts));
+        if (!track.syncSamples.empty()) {
+            Mp4Box stss = fixtureTable("stss", static_cast<uint32_t>(track.syncSamples.size()));
+            for (uint32_t sample : track.syncSamples) appendBE32(stss.payload, sample);
+            stbl.children.push_back(std::move(stss));
+        }
+        stbl.children.push_back(std::move(stsz));
+        stbl.children.push_back(std::move(stsc));
+        stbl.children.push_back(std::move(stco));
+
+        Mp4Box minf = fixtureBox("minf");
+        minf.children.push_back(std::move(stbl));
+        Mp4Box mdia = fixtureBox("mdia");
+        mdia.children.push_back(fixtureBox("mdhd", mdhd));
+        mdia.children.push_back(fixtureBox("hdlr", hdlr));
+        mdia.children.push_back(std::move(minf));
+        trak.children.push_back(std::move(mdia));
+        moov.children.push_back(std::move(trak));
+    }
+    writeBE32(moov.children.front().payload.data() + 16, static_cast<uint32_t>(movieDuration));
+
+    // ftyp, then mdat and moov in the requested order; stco points into the mdat payload
+    const uint64_t dataStart = ftyp.size() + (moovFirst ? moov.size() : 0) + 8;
+    size_t trackIndex = 0;
+    for (auto& trak : moov.children) {
+        if (trak.type != "trak") continue;
+        writeBE32(trak.find("mdia/minf/stbl/stco")->payload.data() + 8,
+                  static_cast<uint32_t>(dataStart + chunkOffsets[trackIndex++]));
+    }
+
+    std::vector<uint8_t> file = ftyp;
+    std::vector<uint8_t> mdat;
+    appendBE32(mdat, static_cast<uint32_t>(8 + data.size()));
+    mdat.insert(mdat.end(), {'m', 'd', 'a', 't'});
+    mdat.insert(mdat.end(), data.begin(), data.end());
+    if (moovFirst) {
+        appendMp4Box(file, moov);
+        file.insert(file.end(), mdat.begin(), mdat.end());
+    } else {
+        file.insert(file.end(), mdat.begin(), mdat.end());
+        appendMp4Box(file, moov);
+    }
+    return file;
+}
+
+// Parses the moov box of a file written by the code under test
+inline bool readFixtureMoov(const std::vector<uint8_t>& file, Mp4Box& moov) {
+    for (const auto& box : scanMp4Boxes(file.data(), 0, file.size())) {
+        if (box.type == "moov") return parseMp4Box(file.data() + box.offset, box.size, moov);
+    }
+    return false;
+}
+
+#endif // MP4_FIXTURE_H
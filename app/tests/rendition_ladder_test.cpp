@@ -0,0 +1,116 @@
+// Produces renditions of a synthetic equirectangular JPEG and decodes them back
+#include <algorithm>
+#include "jpeg_io.h"
+#include "media_metadata.h"
+#include "rendition_ladder.h"
+#include "test_support.h"
+
+namespace {
+
+constexpr int kSourceWidth = 1024;
+constexpr int kSourceHeight = 512;
+
+// Top half red, bottom half blue, with a white stripe on the first columns: the stripe
+// shows up on both edges of a rendition since horizontal taps wrap around
+std::filesystem::path writeSource(const std::filesystem::path& dir) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(kSourceWidth) * kSourceHeight * 3);
+    for (int y = 0; y < kSourceHeight; ++y) {
+        for (int x = 0; x < kSourceWidth; ++x) {
+            uint8_t* p = &pixels[(static_cast<size_t>(y) * kSourceWidth + x) * 3];
+            if (x < 8) {
+                p[0] = p[1] = p[2] = 255;
+            } else if (y < kSourceHeight / 2) {
+                p[0] = 255;
+            } else {
+                p[2] = 255;
+            }
+        }
+    }
+    const auto path = dir / "pano.jpg";
+    CHECK(writeJpegRgb(path.string(), pixels.data(), kSourceWidth, kSourceHeight, 95));
+    return path;
+}
+
+const uint8_t* pixelAt(const std::vector<uint8_t>& pixels, int width, int x, int y) {
+    return &pixels[(static_cast<size_t>(y) * width + x) * 3];
+}
+
+bool near(const uint8_t* p, int r, int g, int b) {
+    return std::abs(p[0] - r) < 40 && std::abs(p[1] - g) < 40 && std::abs(p[2] - b) < 40;
+}
+
+void testLadder(const std::filesystem::path& dir) {
+    const auto source = writeSource(dir);
+    const auto outDir = dir / "out";
+    const std::vector<RenditionSpec> ladder = {
+        {"half", 512, 0, 90},
+        {"small", 256, 128, 85},
+        {"big", 2048, 1024, 90},  // Larger than the source: skipped
+    };
+    const auto metadata = [](int width, int height) {
+        return std::vector<JpegSegment>{
+            buildExifSegment({makeAsciiEntry(ExifIfd::Image, 0x010F, "Insta360")}),
+            buildPanoramaXmpSegment(width, height),
+        };
+    };
+
+    const auto results = generateRenditions(source.string(), outDir.string(), ladder, metadata);
+    CHECK_EQ(results.size(), 2u);
+    const int expectedSize[][2] = {{512, 256}, {256, 128}};
+    for (size_t i = 0; i < results.size() && i < 2; ++i) {
+        const RenditionResult& result = results[i];
+        CHECK(result.success);
+        CHECK_EQ(result.name, ladder[i].name);
+        CHECK_EQ(result.path, (outDir / ("pano_" + ladder[i].name + ".jpg")).string());
+        CHECK_EQ(result.width, expectedSize[i][0]);
+        CHECK_EQ(result.height, expectedSize[i][1]);
+
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        CHECK(readJpegRgb(result.path, pixels, width, height));
+        CHECK_EQ(width, expectedSize[i][0]);
+        CHECK_EQ(height, expectedSize[i][1]);
+        if (width != expectedSize[i][0] || height != expectedSize[i][1]) continue;
+
+        CHECK(near(pixelAt(pixels, width, width / 2, height / 8), 255, 0, 0));
+        CHECK(near(pixelAt(pixels, width, width / 2, height * 7 / 8), 0, 0, 255));
+        CHECK(pixelAt(pixels, width, 0, height / 8)[1] > 60);          // Stripe itself
+        CHECK(pixelAt(pixels, width, width - 1, height / 8)[1] > 10);  // Pulled in across the seam
+
+        // Metadata written by the encoder describes the rendition, not the source
+        const MediaMetadata meta = readMediaMetadata(result.path);
+        CHECK(meta.valid);
+        CHECK_EQ(meta.make, "Insta360");
+        CHECK_EQ(meta.width, width);
+        CHECK_EQ(meta.height, height);
+        const auto bytes = readFileBytes(result.path);
+        const std::string text(bytes.begin(), bytes.end());
+        CHECK(text.find("GPano:FullPanoWidthPixels=\"" + std::to_string(width) + "\"") != std::string::npos);
+    }
+    CHECK(!std::filesystem::exists(outDir / "pano_big.jpg"));
+
+    // Only finished renditions are left behind
+    for (const auto& entry : std::filesystem::directory_iterator(outDir)) {
+        CHECK_EQ(entry.path().extension().string(), ".jpg");
+    }
+}
+
+void testUnreadableSource(const std::filesystem::path& dir) {
+    const auto path = dir / "broken.jpg";
+    writeFileBytes(path, {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F'});
+    const auto outDir = dir / "broken_out";
+    CHECK(generateRenditions(path.string(), outDir.string(), {{"half", 512, 0, 90}}).empty());
+    CHECK(!std::filesystem::exists(outDir / "broken_half.jpg"));
+    CHECK(!std::filesystem::exists(outDir / "broken_half.jpg.tmp"));
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("rendition_ladder_test");
+    testLadder(dir);
+    testUnreadableSource(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
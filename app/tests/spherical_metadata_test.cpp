@@ -0,0 +1,144 @@
+// Injects spherical metadata into synthetic MP4 layouts and parses the result back
+#include <algorithm>
+#include "mp4_fixture.h"
+#include "spherical_metadata.h"
+
+namespace {
+
+const FixtureTrack kVideo;
+
+// Parses the moov of a tagged file and checks the boxes under every video sample entry,
+// and that the first sample is still where stco says
+void checkTagged(const std::vector<uint8_t>& file) {
+    Mp4Box moov;
+    CHECK(readFixtureMoov(file, moov));
+    const Mp4Box* trak = findTrack(moov, "vide");
+    const Mp4Box* entry = trak ? trak->find("mdia/minf/stbl/stsd/avc1") : nullptr;
+    CHECK(entry != nullptr);
+    if (!entry) return;
+
+    CHECK_EQ(entry->payload.size(), 78u);
+    CHECK(entry->child("avcC") != nullptr);
+    const Mp4Box* st3d = entry->child("st3d");
+    CHECK(st3d != nullptr && st3d->payload.size() == 5 && st3d->payload[4] == 0);  // Monoscopic
+    const Mp4Box* svhd = entry->find("sv3d/svhd");
+    CHECK(svhd != nullptr && std::string(svhd->payload.begin() + 4, svhd->payload.end() - 1) == "Insta360 Auto Converter");
+    CHECK(entry->find("sv3d/proj/prhd") != nullptr);
+    const Mp4Box* equi = entry->find("sv3d/proj/equi");
+    CHECK(equi != nullptr && equi->payload.size() == 20);
+
+    const uint32_t offset = readBE32(trak->find("mdia/minf/stbl/stco")->payload.data() + 8);
+    CHECK(offset + 4 <= file.size() && readBE32(file.data() + offset) == fixtureSample(kVideo, 0, 0));
+}
+
+std::vector<std::string> topLevelTypes(const std::vector<uint8_t>& file) {
+    std::vector<std::string> types;
+    for (const auto& box : scanMp4Boxes(file.data(), 0, file.size())) types.push_back(box.type);
+    return types;
+}
+
+void testMoovAtEnd(const std::filesystem::path& dir) {
+    const auto path = dir / "end.mp4";
+    const auto original = buildFixtureMp4({kVideo});
+    writeFileBytes(path, original);
+
+    CHECK(injectSphericalMetadata(path.string()));
+    const auto tagged = readFileBytes(path);
+    checkTagged(tagged);
+    CHECK(topLevelTypes(tagged) == std::vector<std::string>({"ftyp", "mdat", "moov"}));
+    const uint64_t moovOffset = scanMp4Boxes(original.data(), 0, original.size()).back().offset;
+    CHECK(std::equal(original.begin(), original.begin() + moovOffset, tagged.begin()));  // ftyp and mdat untouched
+
+    // A second run finds the boxes and leaves the file alone
+    CHECK(injectSphericalMetadata(path.string()));
+    CHECK(readFileBytes(path) == tagged);
+}
+
+void testGrowIntoPadding(const std::filesystem::path& dir) {
+    const auto path = dir / "padded.mp4";
+    auto original = buildFixtureMp4({kVideo});
+    appendMp4Box(original, fixtureBox("free", std::vector<uint8_t>(500, 0)));
+    writeFileBytes(path, original);
+
+    CHECK(injectSphericalMetadata(path.string()));
+    const auto tagged = readFileBytes(path);
+    checkTagged(tagged);
+    CHECK_EQ(tagged.size(), original.size());
+    CHECK(topLevelTypes(tagged) == std::vector<std::string>({"ftyp", "mdat", "moov", "free"}));
+}
+
+void testRelocateMoov(const std::filesystem::path& dir) {
+    const auto path = dir / "faststart.mp4";
+    const auto original = buildFixtureMp4({kVideo}, 1000, true);
+    writeFileBytes(path, original);
+
+    // moov before mdat without padding: the new moov goes to the end, the old one becomes free
+    CHECK(injectSphericalMetadata(path.string()));
+    const auto tagged = readFileBytes(path);
+    checkTagged(tagged);
+    CHECK(topLevelTypes(tagged) == std::vector<std::string>({"ftyp", "free", "mdat", "moov"}));
+}
+
+void testRelocatePastOpenEndedMdat(const std::filesystem::path& dir) {
+    const auto path = dir / "open_ended.mp4";
+    auto original = buildFixtureMp4({kVideo}, 1000, true);
+    const auto boxes = scanMp4Boxes(original.data(), 0, original.size());
+    const Mp4BoxRef mdat = boxes.back();
+    CHECK_EQ(mdat.type, "mdat");
+    writeBE32(original.data() + mdat.offset, 0);  // Extends to the end of the file
+    writeFileBytes(path, original);
+
+    // The appended moov must not end up inside mdat: mdat gets its explicit size first
+    CHECK(injectSphericalMetadata(path.string()));
+    const auto tagged = readFileBytes(path);
+    checkTagged(tagged);
+    CHECK_EQ(readBE32(tagged.data() + mdat.offset), mdat.size);
+    CHECK(topLevelTypes(tagged) == std::vector<std::string>({"ftyp", "free", "mdat", "moov"}));
+}
+
+void testUnsupportedSampleEntry(const std::filesystem::path& dir) {
+    // A codec the box parser does not know keeps its entry opaque: nothing can be added to it
+    auto original = buildFixtureMp4({kVideo});
+    Mp4Box moov;
+    CHECK(readFixtureMoov(original, moov));
+    moov.find("trak/mdia/minf/stbl/stsd/avc1")->type = "av01";
+    std::vector<uint8_t> bytes;
+    appendMp4Box(bytes, moov);
+    std::copy(bytes.begin(), bytes.end(), original.end() - bytes.size());
+
+    Mp4Box opaque;
+    CHECK(readFixtureMoov(original, opaque));
+    CHECK(addSphericalBoxes(opaque) == SphericalTagging::Unsupported);
+
+    const auto path = dir / "av1.mp4";
+    writeFileBytes(path, original);
+    CHECK(!injectSphericalMetadata(path.string()));
+    CHECK(readFileBytes(path) == original);
+}
+
+void testAddBoxesInMemory() {
+    Mp4Box moov;
+    CHECK(readFixtureMoov(buildFixtureMp4({kVideo}), moov));
+    CHECK(addSphericalBoxes(moov) == SphericalTagging::Tagged);
+    CHECK(addSphericalBoxes(moov) == SphericalTagging::AlreadyTagged);
+
+    Mp4Box audioOnly;
+    FixtureTrack audio;
+    audio.handler = "soun";
+    CHECK(readFixtureMoov(buildFixtureMp4({audio}), audioOnly));
+    CHECK(addSphericalBoxes(audioOnly) == SphericalTagging::Unsupported);
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("spherical_metadata_test");
+    testMoovAtEnd(dir);
+    testGrowIntoPadding(dir);
+    testRelocateMoov(dir);
+    testRelocatePastOpenEndedMdat(dir);
+    testUnsupportedSampleEntry(dir);
+    testAddBoxesInMemory();
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
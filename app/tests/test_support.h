@@ -0,0 +1,66 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Minimal checks for the unit tests: failures are reported and counted, the test goes on
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition "\n"; \
+            ++testFailures();                                                               \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                  \
+    do {                                                                                            \
+        const auto& actualValue = (actual);                                                         \
+        const auto& expectedValue = (expected);                                                     \
+        if (!(actualValue == expectedValue)) {                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ failed: " #actual " is "        \
+                      << actualValue << ", expected " << expectedValue << "\n";                     \
+            ++testFailures();                                                                       \
+        }                                                                                           \
+    } while (0)
+
+// Exit code of the test binary
+inline int testResult() {
+    if (testFailures() > 0) {
+        std::cerr << testFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Empty directory for the files of one test binary
+inline std::filesystem::path makeTestDir(const std::string& name) {
+    const auto dir = std::filesystem::temp_directory_path() / (name + "." + std::to_string(::getpid()));
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+inline std::vector<uint8_t> readFileBytes(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+inline void writeFileBytes(const std::filesystem::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,92 @@
+// Plans chunks from the sync samples of a synthetic video and round-trips the chunk manifest
+#include "media_metadata.h"
+#include "mp4_fixture.h"
+#include "video_chunks.h"
+
+namespace {
+
+// 275 s at 30 fps with a keyframe every 3 s
+MediaMetadata longVideo(const std::filesystem::path& dir) {
+    FixtureTrack video;
+    video.sampleCount = 275 * 30;
+    for (uint32_t sample = 1; sample <= video.sampleCount; sample += 90) video.syncSamples.push_back(sample);
+
+    const auto path = dir / "long.mp4";
+    writeFileBytes(path, buildFixtureMp4({video}));
+    return readMediaMetadata(path.string());
+}
+
+void testChunksStartOnKeyframes(const std::filesystem::path& dir) {
+    const MediaMetadata meta = longVideo(dir);
+    CHECK_EQ(meta.syncSampleMs.size(), 92u);
+
+    // Each range starts on the first keyframe 50 s or more after the previous start; the
+    // 20 s tail is shorter than half a chunk and joins the last range
+    const auto chunks = planVideoChunks(meta, 50.0);
+    const int64_t expected[][2] = {{0, 51000}, {51000, 102000}, {102000, 153000}, {153000, 204000}, {204000, 275000}};
+    CHECK_EQ(chunks.size(), 5u);
+    for (size_t i = 0; i < chunks.size() && i < 5; ++i) {
+        CHECK_EQ(chunks[i].index, static_cast<int>(i));
+        CHECK_EQ(chunks[i].startMs, expected[i][0]);
+        CHECK_EQ(chunks[i].endMs, expected[i][1]);
+        CHECK(!chunks[i].done);
+    }
+
+    // A video shorter than a chunk stays whole
+    const auto single = planVideoChunks(meta, 600.0);
+    CHECK_EQ(single.size(), 1u);
+    CHECK(!single.empty() && single[0].startMs == 0 && single[0].endMs == 275000);
+}
+
+void testNoVideoTrack() {
+    MediaMetadata meta;
+    meta.durationSeconds = 300.0;
+    CHECK(planVideoChunks(meta, 60.0).empty());
+}
+
+void testManifestRoundTrip(const std::filesystem::path& dir) {
+    const std::string chunkDir = (dir / "clip.mp4.chunks").string();
+    std::filesystem::create_directories(chunkDir);
+
+    ChunkPlan plan;
+    plan.source = "/data/input/VID_1.insv";
+    plan.sourceSize = 5000000000ull;
+    plan.width = 5760;
+    plan.height = 2880;
+    plan.bitrate = 40000000;
+    plan.chunks = planVideoChunks(longVideo(dir), 50.0);
+    plan.chunks[0].done = true;
+    plan.chunks[1].done = true;
+    CHECK(saveChunkPlan(chunkDir, plan));
+    CHECK(!std::filesystem::exists(chunkDir + "/manifest.json.tmp"));
+
+    // Only chunk 0 still has its segment: chunk 1 has to be stitched again
+    writeFileBytes(chunkSegmentPath(chunkDir, 0), {0});
+    ChunkPlan loaded;
+    CHECK(loadChunkPlan(chunkDir, loaded));
+    CHECK(loaded.sameSettings(plan));
+    CHECK_EQ(loaded.sourceSize, plan.sourceSize);
+    CHECK_EQ(loaded.chunks.size(), plan.chunks.size());
+    for (size_t i = 0; i < loaded.chunks.size() && i < plan.chunks.size(); ++i) {
+        CHECK_EQ(loaded.chunks[i].startMs, plan.chunks[i].startMs);
+        CHECK_EQ(loaded.chunks[i].endMs, plan.chunks[i].endMs);
+        CHECK_EQ(loaded.chunks[i].done, i == 0);
+    }
+    CHECK_EQ(chunkSegmentPath(chunkDir, 7), chunkDir + "/chunk_007.mp4");
+
+    // Checkpoints made with other settings cannot be reused
+    ChunkPlan resized = plan;
+    resized.width = 3840;
+    CHECK(!loaded.sameSettings(resized));
+}
+
+} // namespace
+
+int main() {
+    const auto dir = makeTestDir("video_chunks_test");
+    testChunksStartOnKeyframes(dir);
+    testNoVideoTrack();
+    testManifestRoundTrip(dir);
+    std::filesystem::remove_all(dir);
+    return testResult();
+}
@@ -0,0 +1,116 @@
+#include "video_chunks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <json/json.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const kManifestName = "manifest.json";
+
+} // namespace
+
+bool ChunkPlan::sameSettings(const ChunkPlan& other) const {
+    return source == other.source && sourceSize == other.sourceSize && width == other.width &&
+           height == other.height && bitrate == other.bitrate && chunks.size() == other.chunks.size();
+}
+
+std::vector<VideoChunk> planVideoChunks(const MediaMetadata& meta, double chunkSeconds) {
+    std::vector<VideoChunk> chunks;
+    const int64_t duration = static_cast<int64_t>(meta.durationSeconds * 1000);
+    if (meta.syncSampleMs.empty() || duration <= 0) {
+        std::cerr << "Warning: No usable video track for chunking: " << meta.path << std::endl;
+        return chunks;
+    }
+
+    // Each range starts on the first sync sample at or after its nominal start
+    const int64_t target = static_cast<int64_t>(std::max(1.0, chunkSeconds) * 1000);
+    std::vector<int64_t> starts = {0};
+    for (int64_t syncTime : meta.syncSampleMs) {
+        if (syncTime >= starts.back() + target && syncTime < duration) {
+            starts.push_back(syncTime);
+        }
+    }
+    // A short tail is merged into the previous range
+    if (starts.size() > 1 && duration - starts.back() < target / 2) {
+        starts.pop_back();
+    }
+
+    for (size_t i = 0; i < starts.size(); ++i) {
+        VideoChunk chunk;
+        chunk.index = static_cast<int>(i);
+        chunk.startMs = starts[i];
+        chunk.endMs = i + 1 < starts.size() ? starts[i + 1] : duration;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+bool loadChunkPlan(const std::string& chunkDir, ChunkPlan& plan) {
+    std::ifstream file(fs::path(chunkDir) / kManifestName);
+    if (!file.is_open()) return false;
+
+    try {
+        Json::Value manifest;
+        file >> manifest;
+        plan.source = manifest["source"].asString();
+        plan.sourceSize = manifest["sourceSize"].asUInt64();
+        plan.width = manifest["width"].asInt();
+        plan.height = manifest["height"].asInt();
+        plan.bitrate = manifest["bitrate"].asInt();
+        plan.chunks.clear();
+        for (const auto& entry : manifest["chunks"]) {
+            VideoChunk chunk;
+            chunk.index = static_cast<int>(plan.chunks.size());
+            chunk.startMs = entry["startMs"].asInt64();
+            chunk.endMs = entry["endMs"].asInt64();
+            // A chunk only counts as done if its segment is still there
+            chunk.done = entry["done"].asBool() && fs::exists(chunkSegmentPath(chunkDir, chunk.index));
+            plan.chunks.push_back(chunk);
+        }
+        return !plan.chunks.empty();
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Invalid chunk manifest in " << chunkDir << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool saveChunkPlan(const std::string& chunkDir, const ChunkPlan& plan) {
+    Json::Value manifest;
+    manifest["source"] = plan.source;
+    manifest["sourceSize"] = static_cast<Json::UInt64>(plan.sourceSize);
+    manifest["width"] = plan.width;
+    manifest["height"] = plan.height;
+    manifest["bitrate"] = plan.bitrate;
+    manifest["chunks"] = Json::Value(Json::arrayValue);
+    for (const auto& chunk : plan.chunks) {
+        Json::Value entry;
+        entry["startMs"] = static_cast<Json::Int64>(chunk.startMs);
+        entry["endMs"] = static_cast<Json::Int64>(chunk.endMs);
+        entry["done"] = chunk.done;
+        manifest["chunks"].append(entry);
+    }
+
+    // Written next to the manifest and renamed, so an interruption never leaves it half written
+    const fs::path path = fs::path(chunkDir) / kManifestName;
+    const std::string tempPath = path.string() + ".tmp";
+    {
+        std::ofstream file(tempPath);
+        file << manifest;
+        if (!file.good()) return false;
+    }
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    return !ec;
+}
+
+std::string chunkSegmentPath(const std::string& chunkDir, int index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "chunk_%03d.mp4", index);
+    return (fs::path(chunkDir) / name).string();
+}
@@ -0,0 +1,47 @@
+#ifndef VIDEO_CHUNKS_H
+#define VIDEO_CHUNKS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "media_metadata.h"
+
+// One time range of a source video, stitched as a separate job
+struct VideoChunk {
+    int index = 0;
+    int64_t startMs = 0;
+    int64_t endMs = 0;
+    bool done = false;  // Stitched and checkpointed in the chunk directory
+};
+
+// Chunk layout of one video plus the settings its chunks were stitched with
+struct ChunkPlan {
+    std::string source;
+    uint64_t sourceSize = 0;
+    int width = 0;
+    int height = 0;
+    int bitrate = 0;
+    std::vector<VideoChunk> chunks;
+
+    // Whether checkpointed chunks of another plan can be reused for this one
+    bool sameSettings(const ChunkPlan& other) const;
+};
+
+/**
+ * Splits a video into ranges of about chunkSeconds, starting every range on a sync sample
+ * (GOP boundary) of the video track so each range decodes on its own.
+ * Planned from the sync sample times of the metadata snapshot; the file is not read again.
+ * Returns an empty list if the snapshot has no usable video track.
+ */
+std::vector<VideoChunk> planVideoChunks(const MediaMetadata& meta, double chunkSeconds);
+
+/**
+ * Reads / atomically writes the manifest.json of a chunk directory.
+ */
+bool loadChunkPlan(const std::string& chunkDir, ChunkPlan& plan);
+bool saveChunkPlan(const std::string& chunkDir, const ChunkPlan& plan);
+
+// Path of the stitched segment of a chunk: <chunkDir>/chunk_007.mp4
+std::string chunkSegmentPath(const std::string& chunkDir, int index);
+
+#endif // VIDEO_CHUNKS_H